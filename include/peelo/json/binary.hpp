@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <peelo/json/exception.hpp>
+#include <peelo/json/utf8.hpp>
+#include <peelo/json/value.hpp>
+#include <peelo/result.hpp>
+
+namespace peelo::json
+{
+  using decode_result = result<value, parse_error>;
+
+  namespace internal
+  {
+    /**
+     * Maximum nesting depth of arrays, maps and tags accepted by the binary
+     * decoders, which decode nested values recursively.
+     */
+    inline constexpr std::size_t max_decode_depth = 512;
+
+    /**
+     * Reads big endian values from a buffer of bytes, checking that the
+     * buffer does not run out.
+     */
+    class byte_reader
+    {
+    public:
+      explicit byte_reader(const std::uint8_t* data, std::size_t size)
+        : m_data(data)
+        , m_size(size)
+        , m_offset(0) {}
+
+      inline std::size_t offset() const
+      {
+        return m_offset;
+      }
+
+      inline std::size_t remaining() const
+      {
+        return m_size - m_offset;
+      }
+
+      inline bool eof() const
+      {
+        return m_offset >= m_size;
+      }
+
+      inline bool peek(std::uint8_t& byte) const
+      {
+        if (eof())
+        {
+          return false;
+        }
+        byte = m_data[m_offset];
+
+        return true;
+      }
+
+      /**
+       * Reads unsigned big endian integer of given number of bytes.
+       */
+      bool read(std::size_t bytes, std::uint64_t& result)
+      {
+        if (remaining() < bytes)
+        {
+          return false;
+        }
+        result = 0;
+        for (std::size_t i = 0; i < bytes; ++i)
+        {
+          result = (result << 8) | m_data[m_offset++];
+        }
+
+        return true;
+      }
+
+      /**
+       * Reads given number of bytes without copying them.
+       */
+      bool read_bytes(std::size_t bytes, const std::uint8_t*& result)
+      {
+        if (remaining() < bytes)
+        {
+          return false;
+        }
+        result = m_data + m_offset;
+        m_offset += bytes;
+
+        return true;
+      }
+
+      bool read_float(double& result)
+      {
+        std::uint64_t bits;
+        float value;
+
+        if (!read(4, bits))
+        {
+          return false;
+        }
+        const auto bits32 = static_cast<std::uint32_t>(bits);
+        std::memcpy(&value, &bits32, sizeof(value));
+        result = value;
+
+        return true;
+      }
+
+      bool read_double(double& result)
+      {
+        std::uint64_t bits;
+
+        if (!read(8, bits))
+        {
+          return false;
+        }
+        std::memcpy(&result, &bits, sizeof(result));
+
+        return true;
+      }
+
+      /**
+       * Reads UTF-8 encoded string of given length in bytes and appends it
+       * into given string.
+       */
+      bool read_utf8(std::size_t bytes, string::value_type& result)
+      {
+        const std::uint8_t* data;
+
+        return read_bytes(bytes, data) && decode_utf8(data, bytes, result);
+      }
+
+      decode_result error(const std::string& message) const
+      {
+        return decode_result::error({
+          { 1, static_cast<int>(m_offset + 1), m_offset },
+          message
+        });
+      }
+
+    private:
+      const std::uint8_t* m_data;
+      const std::size_t m_size;
+      std::size_t m_offset;
+    };
+
+    inline void
+    write_big_endian(
+      std::vector<std::uint8_t>& output,
+      std::uint64_t value,
+      std::size_t bytes
+    )
+    {
+      for (std::size_t i = bytes; i > 0; --i)
+      {
+        output.push_back(static_cast<std::uint8_t>(value >> ((i - 1) * 8)));
+      }
+    }
+
+    inline void
+    write_double(std::vector<std::uint8_t>& output, double value)
+    {
+      std::uint64_t bits;
+
+      std::memcpy(&bits, &value, sizeof(bits));
+      write_big_endian(output, bits, 8);
+    }
+
+    /**
+     * Returns length of given string encoded in UTF-8.
+     */
+    inline std::size_t
+    utf8_length(std::u32string_view value)
+    {
+      std::size_t length = 0;
+
+      for (const auto c : value)
+      {
+        length += utf8_length(c);
+      }
+
+      return length;
+    }
+
+    /**
+     * Appends given string encoded in UTF-8 into given output. Code points
+     * which are not Unicode scalar values are replaced with the replacement
+     * character.
+     */
+    inline void
+    write_utf8(std::vector<std::uint8_t>& output, std::u32string_view value)
+    {
+      char buffer[4];
+
+      for (const auto c : value)
+      {
+        if (c < 0x80)
+        {
+          output.push_back(static_cast<std::uint8_t>(c));
+          continue;
+        }
+
+        const auto length = encode_utf8(
+          is_unicode_scalar_value(c) ? c : 0xfffd,
+          buffer
+        );
+
+        output.insert(std::end(output), buffer, buffer + length);
+      }
+    }
+
+    /**
+     * Returns given number as signed integer, if it should be encoded as
+     * one in binary formats. Numbers which are too large for signed integer
+     * are stored as unsigned integers and must be checked for first.
+     */
+    inline std::optional<std::int64_t>
+    binary_int64(const number& n)
+    {
+      // Negative zero is encoded as floating point to keep it's sign.
+      if (n.kind() != number::kind::int64)
+      {
+        const auto d = n.value();
+
+        if (d == 0.0 && std::signbit(d))
+        {
+          return std::nullopt;
+        }
+      }
+
+      return n.as_int64();
+    }
+  }
+}
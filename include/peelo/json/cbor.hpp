@@ -0,0 +1,540 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+#include <peelo/json/binary.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    enum cbor_major_type
+    {
+      cbor_unsigned = 0,
+      cbor_negative = 1,
+      cbor_bytes = 2,
+      cbor_text = 3,
+      cbor_array = 4,
+      cbor_map = 5,
+      cbor_tag = 6,
+      cbor_simple = 7,
+    };
+
+    /**
+     * Additional information which marks indefinite length.
+     */
+    inline constexpr std::uint8_t cbor_indefinite = 31;
+
+    inline constexpr std::uint8_t cbor_break = 0xff;
+
+    inline void
+    cbor_write_head(
+      std::vector<std::uint8_t>& output,
+      cbor_major_type major,
+      std::uint64_t argument
+    )
+    {
+      const auto prefix = static_cast<std::uint8_t>(major << 5);
+
+      if (argument < 24)
+      {
+        output.push_back(prefix | static_cast<std::uint8_t>(argument));
+      }
+      else if (argument <= 0xff)
+      {
+        output.push_back(prefix | 24);
+        write_big_endian(output, argument, 1);
+      }
+      else if (argument <= 0xffff)
+      {
+        output.push_back(prefix | 25);
+        write_big_endian(output, argument, 2);
+      }
+      else if (argument <= 0xffffffff)
+      {
+        output.push_back(prefix | 26);
+        write_big_endian(output, argument, 4);
+      } else {
+        output.push_back(prefix | 27);
+        write_big_endian(output, argument, 8);
+      }
+    }
+
+    inline void
+    cbor_write_string(
+      std::vector<std::uint8_t>& output,
+      std::u32string_view value
+    )
+    {
+      cbor_write_head(output, cbor_text, utf8_length(value));
+      write_utf8(output, value);
+    }
+
+    inline void
+    cbor_encode(std::vector<std::uint8_t>& output, const value& v)
+    {
+      switch (type_of(v))
+      {
+        case type::array:
+          {
+            const auto& elements = as_ref<array>(v).elements();
+
+            cbor_write_head(output, cbor_array, elements.size());
+            for (const auto& element : elements)
+            {
+              cbor_encode(output, element);
+            }
+          }
+          break;
+
+        case type::boolean:
+          output.push_back(as_ref<boolean>(v).value() ? 0xf5 : 0xf4);
+          break;
+
+        case type::null:
+          output.push_back(0xf6);
+          break;
+
+        case type::number:
+          {
+            const auto& n = as_ref<number>(v);
+
+            if (n.kind() == number::kind::uint64)
+            {
+              cbor_write_head(output, cbor_unsigned, *n.as_uint64());
+            }
+            else if (const auto i = binary_int64(n))
+            {
+              if (*i >= 0)
+              {
+                cbor_write_head(
+                  output,
+                  cbor_unsigned,
+                  static_cast<std::uint64_t>(*i)
+                );
+              } else {
+                cbor_write_head(
+                  output,
+                  cbor_negative,
+                  static_cast<std::uint64_t>(-(*i + 1))
+                );
+              }
+            } else {
+              output.push_back(0xfb);
+              write_double(output, n.value());
+            }
+          }
+          break;
+
+        case type::object:
+          {
+            const auto& properties = as_ref<object>(v).properties();
+
+            cbor_write_head(output, cbor_map, properties.size());
+            for (const auto& property : properties)
+            {
+              cbor_write_string(output, property.first);
+              cbor_encode(output, property.second);
+            }
+          }
+          break;
+
+        case type::string:
+          cbor_write_string(output, as_ref<string>(v).value());
+          break;
+      }
+    }
+
+    inline double
+    cbor_decode_half(std::uint16_t half)
+    {
+      const int exponent = (half >> 10) & 0x1f;
+      const int mantissa = half & 0x3ff;
+      double result;
+
+      if (exponent == 0)
+      {
+        result = std::ldexp(mantissa, -24);
+      }
+      else if (exponent != 31)
+      {
+        result = std::ldexp(mantissa + 1024, exponent - 25);
+      } else {
+        result = mantissa == 0
+          ? std::numeric_limits<double>::infinity()
+          : std::numeric_limits<double>::quiet_NaN();
+      }
+
+      return half & 0x8000 ? -result : result;
+    }
+
+    /**
+     * Reads argument of a data item head with given additional information.
+     */
+    inline bool
+    cbor_read_argument(
+      byte_reader& reader,
+      std::uint8_t info,
+      std::uint64_t& result
+    )
+    {
+      if (info < 24)
+      {
+        result = info;
+
+        return true;
+      }
+      else if (info > 27)
+      {
+        return false;
+      }
+
+      return reader.read(std::size_t(1) << (info - 24), result);
+    }
+
+    /**
+     * Reads text string, which might be split into chunks if it has
+     * indefinite length, and appends it into given string.
+     */
+    inline bool
+    cbor_read_text(
+      byte_reader& reader,
+      std::uint8_t info,
+      string::value_type& result
+    )
+    {
+      std::uint64_t length;
+
+      if (info != cbor_indefinite)
+      {
+        return cbor_read_argument(reader, info, length)
+          && reader.read_utf8(length, result);
+      }
+      for (;;)
+      {
+        std::uint64_t head;
+
+        if (!reader.read(1, head))
+        {
+          return false;
+        }
+        else if (head == cbor_break)
+        {
+          return true;
+        }
+        else if (
+          (head >> 5) != cbor_text ||
+          (head & 0x1f) == cbor_indefinite ||
+          !cbor_read_argument(reader, head & 0x1f, length) ||
+          !reader.read_utf8(length, result)
+        )
+        {
+          return false;
+        }
+      }
+    }
+
+    /**
+     * Determines whether there is another element in a container, which
+     * has either given number of remaining elements or indefinite length.
+     */
+    inline bool
+    cbor_has_next(
+      byte_reader& reader,
+      bool indefinite,
+      std::uint64_t& remaining
+    )
+    {
+      std::uint8_t byte;
+      std::uint64_t ignored;
+
+      if (!indefinite)
+      {
+        return remaining-- > 0;
+      }
+      else if (reader.peek(byte) && byte == cbor_break)
+      {
+        reader.read(1, ignored);
+
+        return false;
+      }
+
+      return true;
+    }
+
+    inline decode_result
+    cbor_decode(
+      byte_reader& reader,
+      std::pmr::memory_resource* resource,
+      std::size_t depth = 0
+    )
+    {
+      std::uint64_t head;
+      std::uint64_t argument = 0;
+
+      if (depth > max_decode_depth)
+      {
+        return reader.error("Maximum nesting depth exceeded.");
+      }
+      else if (!reader.read(1, head))
+      {
+        return reader.error("Unexpected end of input; Missing value.");
+      }
+
+      const auto major = static_cast<cbor_major_type>(head >> 5);
+      const auto info = static_cast<std::uint8_t>(head & 0x1f);
+      const bool indefinite = info == cbor_indefinite;
+
+      // Only strings and containers can have indefinite length.
+      if (
+        major != cbor_simple &&
+        (indefinite
+          ? major < cbor_bytes || major > cbor_map
+          : !cbor_read_argument(reader, info, argument))
+      )
+      {
+        return reader.error("Malformed data item head.");
+      }
+
+      switch (major)
+      {
+        case cbor_unsigned:
+          return decode_result::ok(number::make(argument, resource));
+
+        case cbor_negative:
+          if (argument <= std::numeric_limits<std::int64_t>::max())
+          {
+            return decode_result::ok(number::make(
+              -1 - static_cast<std::int64_t>(argument),
+              resource
+            ));
+          }
+
+          return decode_result::ok(number::make(
+            -1.0 - static_cast<double>(argument),
+            resource
+          ));
+
+        case cbor_bytes:
+          return reader.error("Byte strings are not supported.");
+
+        case cbor_text:
+          {
+            string::value_type result(resource);
+
+            if (
+              (indefinite && !cbor_read_text(reader, info, result)) ||
+              (!indefinite && !reader.read_utf8(argument, result))
+            )
+            {
+              return reader.error("Malformed text string.");
+            }
+
+            return decode_result::ok(
+              make_node<string>(resource, std::move(result))
+            );
+          }
+
+        case cbor_array:
+          {
+            array::container_type elements(resource);
+
+            // Every element takes at least one byte, which limits how much
+            // memory can be reserved up front.
+            if (!indefinite)
+            {
+              elements.reserve(std::min<std::uint64_t>(
+                argument,
+                reader.remaining()
+              ));
+            }
+            while (cbor_has_next(reader, indefinite, argument))
+            {
+              const auto element = cbor_decode(reader, resource, depth + 1);
+
+              if (!element)
+              {
+                return element;
+              }
+              elements.push_back(*element);
+            }
+
+            return decode_result::ok(
+              make_node<array>(resource, std::move(elements))
+            );
+          }
+
+        case cbor_map:
+          {
+            object::container_type properties(resource);
+
+            while (cbor_has_next(reader, indefinite, argument))
+            {
+              std::uint64_t key_head;
+              object::key_type key(resource);
+
+              if (
+                !reader.read(1, key_head) ||
+                (key_head >> 5) != cbor_text ||
+                !cbor_read_text(reader, key_head & 0x1f, key)
+              )
+              {
+                return reader.error("Map keys must be text strings.");
+              }
+
+              const auto property = cbor_decode(
+                reader,
+                resource,
+                depth + 1
+              );
+
+              if (!property)
+              {
+                return property;
+              }
+              properties.insert_or_assign(std::move(key), *property);
+            }
+
+            return decode_result::ok(
+              make_node<object>(resource, std::move(properties))
+            );
+          }
+
+        case cbor_tag:
+          // Tags only give additional meaning to the tagged value, which is
+          // decoded as it is.
+          return cbor_decode(reader, resource, depth + 1);
+
+        case cbor_simple:
+          break;
+      }
+
+      switch (info)
+      {
+        case 20:
+          return decode_result::ok(boolean::make(false, resource));
+
+        case 21:
+          return decode_result::ok(boolean::make(true, resource));
+
+        case 22:
+        case 23:
+          return decode_result::ok(nullptr);
+
+        case 25:
+          if (reader.read(2, argument))
+          {
+            return decode_result::ok(number::make(
+              cbor_decode_half(static_cast<std::uint16_t>(argument)),
+              resource
+            ));
+          }
+          break;
+
+        case 26:
+          {
+            double result;
+
+            if (reader.read_float(result))
+            {
+              return decode_result::ok(number::make(result, resource));
+            }
+          }
+          break;
+
+        case 27:
+          {
+            double result;
+
+            if (reader.read_double(result))
+            {
+              return decode_result::ok(number::make(result, resource));
+            }
+          }
+          break;
+
+        default:
+          return reader.error("Unsupported simple value.");
+      }
+
+      return reader.error("Unexpected end of input; Missing number.");
+    }
+  }
+
+  /**
+   * Encodes given JSON value in CBOR (RFC 8949). Integers are encoded as
+   * integers and other numbers as double precision floating point values.
+   */
+  inline std::vector<std::uint8_t>
+  encode_cbor(const value& v)
+  {
+    std::vector<std::uint8_t> result;
+
+    internal::cbor_encode(result, v);
+
+    return result;
+  }
+
+  /**
+   * Decodes JSON value from CBOR encoded data. Byte strings, and maps with
+   * other than text string keys are not supported since they have no JSON
+   * representation, while tags are ignored and undefined is decoded as
+   * null. Arrays, maps and tags can be nested at most 512 levels deep.
+   * Position of errors is given as byte offset.
+   */
+  inline decode_result
+  decode_cbor(
+    const std::uint8_t* data,
+    std::size_t size,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+  )
+  {
+    internal::byte_reader reader(data, size);
+    const auto result = internal::cbor_decode(reader, resource);
+
+    if (result && !reader.eof())
+    {
+      return reader.error("Unexpected input.");
+    }
+
+    return result;
+  }
+
+  inline decode_result
+  decode_cbor(
+    const std::vector<std::uint8_t>& data,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+  )
+  {
+    return decode_cbor(data.data(), data.size(), resource);
+  }
+}
@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+#if !defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+    /**
+     * Reference counted storage for values which do not fit inside a
+     * compact value. The box is allocated from the same memory resource as
+     * the value it holds.
+     */
+    struct compact_box
+    {
+      std::atomic<std::size_t> references;
+      std::pmr::memory_resource* const resource;
+      const value node;
+    };
+
+    /**
+     * Returns memory resource used by given array, object or string.
+     */
+    inline std::pmr::memory_resource*
+    resource_of(const value& v)
+    {
+      switch (type_of(v))
+      {
+        case type::array:
+          return as_ref<array>(v).elements().get_allocator().resource();
+
+        case type::object:
+          return as_ref<object>(v).properties().get_allocator().resource();
+
+        case type::string:
+          return as_ref<string>(v).value().get_allocator().resource();
+
+        default:
+          return std::pmr::get_default_resource();
+      }
+    }
+#endif
+  }
+
+  /**
+   * Compact 16 byte handle to a JSON value. Null, booleans, numbers and
+   * strings with no more than `max_inline_length` characters are stored
+   * inside the handle itself, so they require no heap allocation, no
+   * control block and no reference counting. Arrays, objects and longer
+   * strings are stored as ordinary JSON values in shared, reference counted
+   * storage allocated from the memory resource of the value. With intrusive
+   * reference counting the handle refers to the value directly instead.
+   *
+   * Compact values are meant for storing large amounts of scalars, such as
+   * columns of numbers extracted from a document. Elements of arrays and
+   * properties of objects are still ordinary JSON values.
+   */
+  class compact_value final
+  {
+  public:
+    /**
+     * Maximum length of a string that is stored inside the handle.
+     */
+    static constexpr std::size_t max_inline_length = 3;
+
+    /**
+     * Constructs null value.
+     */
+    compact_value() noexcept
+      : m_chars{}
+      , m_type(static_cast<std::uint8_t>(type::null))
+      , m_length(0) {}
+
+    /**
+     * Constructs null value.
+     */
+    explicit compact_value(std::nullptr_t) noexcept
+      : compact_value() {}
+
+    explicit compact_value(bool value) noexcept
+      : m_chars{}
+      , m_type(static_cast<std::uint8_t>(type::boolean))
+      , m_length(0)
+    {
+      store(value);
+    }
+
+    explicit compact_value(double value) noexcept
+      : m_chars{}
+      , m_type(static_cast<std::uint8_t>(type::number))
+      , m_length(static_cast<std::uint8_t>(number::kind::floating))
+    {
+      store(value);
+    }
+
+    /**
+     * Constructs number value which stores given integer exactly.
+     */
+    template<
+      class T,
+      std::enable_if_t<
+        std::is_integral_v<T> && !std::is_same_v<T, bool>,
+        int
+      > = 0
+    >
+    explicit compact_value(T value) noexcept
+      : m_chars{}
+      , m_type(static_cast<std::uint8_t>(type::number))
+      , m_length(0)
+    {
+      if constexpr (std::is_signed_v<T>)
+      {
+        m_length = static_cast<std::uint8_t>(number::kind::int64);
+        store(static_cast<std::int64_t>(value));
+      }
+      else if (
+        value <= static_cast<T>(std::numeric_limits<std::int64_t>::max())
+      )
+      {
+        m_length = static_cast<std::uint8_t>(number::kind::int64);
+        store(static_cast<std::int64_t>(value));
+      } else {
+        m_length = static_cast<std::uint8_t>(number::kind::uint64);
+        store(static_cast<std::uint64_t>(value));
+      }
+    }
+
+    /**
+     * Constructs string value. Strings longer than `max_inline_length` are
+     * allocated from given memory resource.
+     */
+    explicit compact_value(
+      std::u32string_view value,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+      : m_chars{}
+      , m_type(static_cast<std::uint8_t>(type::string))
+      , m_length(0)
+    {
+      if (value.length() <= max_inline_length)
+      {
+        value.copy(m_chars, value.length());
+        m_length = static_cast<std::uint8_t>(value.length());
+      } else {
+        share(string::make(value, resource));
+      }
+    }
+
+    explicit compact_value(
+      const char32_t* value,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+      : compact_value(std::u32string_view(value), resource) {}
+
+    /**
+     * Converts an ordinary JSON value into compact value. Scalars are
+     * copied into the handle, while arrays, objects and long strings are
+     * shared. Integers are kept exact, but numbers stored as decimal digits
+     * are converted into double.
+     */
+    explicit compact_value(const value& v)
+      : compact_value()
+    {
+      switch (type_of(v))
+      {
+        case type::boolean:
+          *this = compact_value(as_ref<boolean>(v).value());
+          break;
+
+        case type::number:
+          {
+            const auto& n = as_ref<number>(v);
+
+            switch (n.kind())
+            {
+              case number::kind::int64:
+                *this = compact_value(*n.as_int64());
+                break;
+
+              case number::kind::uint64:
+                *this = compact_value(*n.as_uint64());
+                break;
+
+              default:
+                *this = compact_value(n.value());
+                break;
+            }
+          }
+          break;
+
+        case type::string:
+          if (as_ref<string>(v).value().length() <= max_inline_length)
+          {
+            *this = compact_value(std::u32string_view(
+              as_ref<string>(v).value()
+            ));
+            break;
+          }
+          [[fallthrough]];
+
+        case type::array:
+        case type::object:
+          share(v);
+          m_type = static_cast<std::uint8_t>(type_of(v));
+          break;
+
+        case type::null:
+          break;
+      }
+    }
+
+    compact_value(const compact_value& that) noexcept
+      : m_type(that.m_type)
+      , m_length(that.m_length)
+    {
+      copy_payload(that);
+      retain();
+    }
+
+    compact_value(compact_value&& that) noexcept
+      : m_type(that.m_type)
+      , m_length(that.m_length)
+    {
+      copy_payload(that);
+      that.m_type = static_cast<std::uint8_t>(type::null);
+      that.m_length = 0;
+    }
+
+    ~compact_value()
+    {
+      release();
+    }
+
+    compact_value& operator=(const compact_value& that) noexcept
+    {
+      if (this != &that)
+      {
+        that.retain();
+        release();
+        m_type = that.m_type;
+        m_length = that.m_length;
+        copy_payload(that);
+      }
+
+      return *this;
+    }
+
+    compact_value& operator=(compact_value&& that) noexcept
+    {
+      if (this != &that)
+      {
+        release();
+        m_type = that.m_type;
+        m_length = that.m_length;
+        copy_payload(that);
+        that.m_type = static_cast<std::uint8_t>(type::null);
+        that.m_length = 0;
+      }
+
+      return *this;
+    }
+
+    /**
+     * Returns type of the value.
+     */
+    inline enum type type() const
+    {
+      return static_cast<enum type>(m_type);
+    }
+
+    /**
+     * Returns true if the value is stored inside the handle.
+     */
+    inline bool is_inline() const
+    {
+      return !is_boxed();
+    }
+
+    /**
+     * Returns value of a boolean. No type checking is done.
+     */
+    inline bool as_boolean() const
+    {
+      return load<bool>();
+    }
+
+    /**
+     * Returns the way a number is stored, which is either floating, int64
+     * or uint64. No type checking is done.
+     */
+    inline enum number::kind number_kind() const
+    {
+      return static_cast<enum number::kind>(m_length);
+    }
+
+    /**
+     * Returns value of a number as double. No type checking is done.
+     */
+    inline double as_number() const
+    {
+      switch (number_kind())
+      {
+        case number::kind::int64:
+          return static_cast<double>(load<std::int64_t>());
+
+        case number::kind::uint64:
+          return static_cast<double>(load<std::uint64_t>());
+
+        default:
+          return load<double>();
+      }
+    }
+
+    /**
+     * Returns value of a number as 64-bit signed integer, if it's stored as
+     * one. No type checking is done.
+     */
+    inline std::optional<std::int64_t> as_int64() const
+    {
+      if (number_kind() == number::kind::int64)
+      {
+        return load<std::int64_t>();
+      }
+
+      return std::nullopt;
+    }
+
+    /**
+     * Returns value of a number as 64-bit unsigned integer, if it's stored
+     * as one. No type checking is done.
+     */
+    inline std::optional<std::uint64_t> as_uint64() const
+    {
+      if (number_kind() == number::kind::uint64)
+      {
+        return load<std::uint64_t>();
+      }
+
+      return std::nullopt;
+    }
+
+    /**
+     * Returns value of a string. No type checking is done. The view is
+     * valid as long as this handle is.
+     */
+    inline std::u32string_view as_string() const
+    {
+      if (is_boxed())
+      {
+        return static_cast<const string&>(shared()).value();
+      }
+
+      return std::u32string_view(m_chars, m_length);
+    }
+
+    /**
+     * Converts the compact value into an ordinary JSON value. Shared values
+     * are returned as they are, while scalars are allocated from given
+     * memory resource.
+     */
+    value to_value(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    ) const
+    {
+      if (is_boxed())
+      {
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+        return value(const_cast<internal::base*>(&shared()));
+#else
+        return box()->node;
+#endif
+      }
+      switch (type())
+      {
+        case type::boolean:
+          return boolean::make(as_boolean(), resource);
+
+        case type::number:
+          switch (number_kind())
+          {
+            case number::kind::int64:
+              return number::make(*as_int64(), resource);
+
+            case number::kind::uint64:
+              return number::make(*as_uint64(), resource);
+
+            default:
+              return number::make(as_number(), resource);
+          }
+
+        case type::string:
+          return string::make(as_string(), resource);
+
+        default:
+          return nullptr;
+      }
+    }
+
+  private:
+    /**
+     * Length used for marking values which are stored in shared storage.
+     */
+    static constexpr std::uint8_t boxed_length = 0xff;
+
+    inline bool is_boxed() const
+    {
+      return m_length == boxed_length;
+    }
+
+    inline void copy_payload(const compact_value& that)
+    {
+      std::memcpy(m_chars, that.m_chars, sizeof(m_chars));
+    }
+
+    /**
+     * Stores given array, object or string into shared storage.
+     */
+    inline void share(const value& v)
+    {
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      v->retain();
+      store(static_cast<const internal::base*>(v.get()));
+#else
+      const auto resource = internal::resource_of(v);
+      std::pmr::polymorphic_allocator<internal::compact_box> allocator(
+        resource
+      );
+      const auto box = allocator.allocate(1);
+
+      ::new (static_cast<void*>(box)) internal::compact_box{
+        { 1 },
+        resource,
+        v
+      };
+      store(box);
+#endif
+      m_length = boxed_length;
+    }
+
+    /**
+     * Returns the value in shared storage.
+     */
+    inline const internal::base& shared() const
+    {
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      return *load<const internal::base*>();
+#else
+      return *box()->node;
+#endif
+    }
+
+    inline void retain() const
+    {
+      if (!is_boxed())
+      {
+        return;
+      }
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      shared().retain();
+#else
+      box()->references.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    inline void release()
+    {
+      if (!is_boxed())
+      {
+        return;
+      }
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      shared().release();
+#else
+      const auto box = this->box();
+
+      if (box->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+      {
+        std::pmr::polymorphic_allocator<internal::compact_box> allocator(
+          box->resource
+        );
+
+        box->~compact_box();
+        allocator.deallocate(box, 1);
+      }
+#endif
+    }
+
+    /**
+     * Booleans, numbers and pointers to shared storage are copied in and
+     * out of the character storage, so that it can be shared by all types
+     * without making the handle larger.
+     */
+    template<class T>
+    inline T load() const
+    {
+      T result;
+
+      std::memcpy(&result, m_chars, sizeof(T));
+
+      return result;
+    }
+
+    template<class T>
+    inline void store(T value)
+    {
+      std::memcpy(m_chars, &value, sizeof(T));
+    }
+
+#if !defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+    inline internal::compact_box* box() const
+    {
+      return load<internal::compact_box*>();
+    }
+#endif
+
+    alignas(double) char32_t m_chars[max_inline_length];
+    std::uint8_t m_type;
+    std::uint8_t m_length;
+  };
+
+  static_assert(sizeof(compact_value) == 16);
+
+  /**
+   * Returns type of given compact value.
+   */
+  inline enum type
+  type_of(const compact_value& v)
+  {
+    return v.type();
+  }
+
+  /**
+   * Converts given compact value into JSON value of given type. Notice that
+   * no type checking is done, so you need to do that yourself first with
+   * `type_of` function. Arrays, objects and long strings are returned
+   * without allocating anything.
+   */
+  template<class T>
+  inline typename T::ptr
+  as(const compact_value& v)
+  {
+    return internal::node_cast<T>(v.to_value());
+  }
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  /**
+   * Iterates over a JSON value and all of it's descendants in pre-order,
+   * using an explicit stack instead of recursion, so arbitrarily deep values
+   * can be traversed. Children of the current value can be skipped with
+   * `skip_children()`, and iteration can be stopped at any time, so a
+   * traversal costs only as much as the part of the tree it visits.
+   *
+   * Properties of objects are visited in unspecified order. The cursor
+   * keeps the root value alive.
+   *
+   * ```cpp
+   * cursor c(root);
+   *
+   * while (c.next())
+   * {
+   *   if (c.depth() == 2)
+   *   {
+   *     c.skip_children();
+   *   }
+   * }
+   * ```
+   */
+  class cursor
+  {
+  public:
+    /**
+     * Location of a value inside it's parent.
+     */
+    struct path_element
+    {
+      /**
+       * Type of the parent, either array or object.
+       */
+      enum type parent;
+
+      /**
+       * Index of the value, if the parent is an array.
+       */
+      std::size_t index;
+
+      /**
+       * Name of the property, if the parent is an object.
+       */
+      std::u32string_view key;
+    };
+
+    explicit cursor(const value& root)
+      : m_root(root)
+      , m_current(nullptr)
+      , m_skip(false)
+      , m_finished(false) {}
+
+    /**
+     * Advances to the next value. The first call advances to the root
+     * value. Returns false once all values have been visited.
+     */
+    bool next()
+    {
+      if (!m_current)
+      {
+        if (m_finished)
+        {
+          return false;
+        }
+        m_current = &m_root;
+
+        return true;
+      }
+
+      if (!m_skip)
+      {
+        push(*m_current);
+      }
+      m_skip = false;
+
+      while (!m_stack.empty())
+      {
+        auto& top = m_stack.back();
+        auto& element = m_path.back();
+
+        if (top.parent == type::array)
+        {
+          if (top.element != top.elements_end)
+          {
+            element.index = static_cast<std::size_t>(
+              top.element - top.elements_begin
+            );
+            m_current = &*top.element++;
+
+            return true;
+          }
+        }
+        else if (top.property != top.properties_end)
+        {
+          element.key = top.property->first;
+          m_current = &top.property->second;
+          ++top.property;
+
+          return true;
+        }
+        m_stack.pop_back();
+        m_path.pop_back();
+      }
+      m_current = nullptr;
+      m_finished = true;
+
+      return false;
+    }
+
+    /**
+     * Prevents children of the current value from being visited.
+     */
+    inline void skip_children()
+    {
+      m_skip = true;
+    }
+
+    /**
+     * Returns the current value.
+     */
+    inline const value& current() const
+    {
+      return *m_current;
+    }
+
+    /**
+     * Returns depth of the current value, which is zero for the root value.
+     */
+    inline std::size_t depth() const
+    {
+      return m_path.size();
+    }
+
+    /**
+     * Returns location of the current value, starting from the root value.
+     */
+    inline const std::vector<path_element>& path() const
+    {
+      return m_path;
+    }
+
+  private:
+    struct frame
+    {
+      enum type parent;
+      array::container_type::const_iterator elements_begin;
+      array::container_type::const_iterator element;
+      array::container_type::const_iterator elements_end;
+      object::container_type::const_iterator property;
+      object::container_type::const_iterator properties_end;
+    };
+
+    void push(const value& v)
+    {
+      const auto t = type_of(v);
+      frame f;
+
+      if (t == type::array)
+      {
+        const auto& elements = as_ref<array>(v).elements();
+
+        if (elements.empty())
+        {
+          return;
+        }
+        f.elements_begin = f.element = std::begin(elements);
+        f.elements_end = std::end(elements);
+      }
+      else if (t == type::object)
+      {
+        const auto& properties = as_ref<object>(v).properties();
+
+        if (properties.empty())
+        {
+          return;
+        }
+        f.property = std::begin(properties);
+        f.properties_end = std::end(properties);
+      } else {
+        return;
+      }
+      f.parent = t;
+      m_stack.push_back(f);
+      m_path.push_back({ t, 0, std::u32string_view() });
+    }
+
+    const value m_root;
+    const value* m_current;
+    bool m_skip;
+    bool m_finished;
+    std::vector<frame> m_stack;
+    std::vector<path_element> m_path;
+  };
+}
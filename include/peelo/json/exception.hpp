@@ -25,6 +25,7 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <exception>
 #include <string>
 
@@ -37,6 +38,10 @@ namespace peelo::json
   {
     int line;
     int column;
+    /**
+     * Offset in code points from the beginning of the source code.
+     */
+    std::size_t offset = 0;
   };
 
   /**
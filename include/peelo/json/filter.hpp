@@ -0,0 +1,770 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <peelo/json/parser.hpp>
+#include <peelo/json/utf8.hpp>
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  /**
+   * Enumeration of comparisons that filter predicates can make.
+   */
+  enum class filter_operator
+  {
+    equal,
+    not_equal,
+    less,
+    less_equal,
+    greater,
+    greater_equal,
+  };
+
+  /**
+   * Enumeration of ways to combine predicates of a filter.
+   */
+  enum class filter_mode
+  {
+    /**
+     * Record matches when any of the predicates is true.
+     */
+    any,
+    /**
+     * Record matches when all of the predicates are true.
+     */
+    all,
+  };
+
+  /**
+   * Predicate which compares value of a property, found from given path of
+   * property names, against an operand. Operand can be a string, number,
+   * boolean or null. Predicate is false when the path does not exist in the
+   * record or the property is of different type than the operand. Strings
+   * are compared by their code points and numbers as doubles, while booleans
+   * and null can only be compared for equality.
+   */
+  struct filter_predicate
+  {
+    std::vector<std::u32string> path;
+    filter_operator op;
+    value operand;
+  };
+
+  namespace internal
+  {
+    inline std::string
+    filter_utf8(std::u32string_view input)
+    {
+      std::string result;
+      char buffer[4];
+
+      result.reserve(input.length());
+      for (const auto c : input)
+      {
+        result.append(
+          buffer,
+          encode_utf8(is_unicode_scalar_value(c) ? c : 0xfffd, buffer)
+        );
+      }
+
+      return result;
+    }
+
+    template<class T>
+    inline bool
+    filter_compare(filter_operator op, const T& a, const T& b)
+    {
+      switch (op)
+      {
+        case filter_operator::equal:
+          return a == b;
+
+        case filter_operator::not_equal:
+          return a != b;
+
+        case filter_operator::less:
+          return a < b;
+
+        case filter_operator::less_equal:
+          return a <= b;
+
+        case filter_operator::greater:
+          return a > b;
+
+        case filter_operator::greater_equal:
+          return a >= b;
+      }
+
+      return false;
+    }
+
+    /**
+     * Scans raw UTF-8 encoded JSON without parsing it, skipping over values
+     * which are not interesting. Malformed input simply makes the scan fail.
+     */
+    class raw_scanner
+    {
+    public:
+      explicit raw_scanner(std::string_view input)
+        : m_current(input.data())
+        , m_end(input.data() + input.length()) {}
+
+      /**
+       * Looks up value from given path of property names and returns it's
+       * raw source code.
+       */
+      bool find(
+        const std::vector<std::string>& path,
+        std::string_view& token,
+        std::string& scratch
+      )
+      {
+        for (const auto& name : path)
+        {
+          if (!find_property(name, scratch))
+          {
+            return false;
+          }
+        }
+        skip_whitespace();
+
+        const auto start = m_current;
+
+        if (!skip_value() || m_current == start)
+        {
+          return false;
+        }
+        token = std::string_view(
+          start,
+          static_cast<std::size_t>(m_current - start)
+        );
+
+        return true;
+      }
+
+      /**
+       * Returns contents of string literal in given token, with escape
+       * sequences decoded only if there are any.
+       */
+      static bool read_string(
+        std::string_view token,
+        std::string_view& result,
+        std::string& scratch
+      )
+      {
+        const auto contents = token.substr(1, token.length() - 2);
+
+        if (contents.find('\\') == std::string_view::npos)
+        {
+          result = contents;
+
+          return true;
+        }
+        scratch.clear();
+        for (std::size_t i = 0; i < contents.length(); ++i)
+        {
+          char32_t c = 0;
+          char buffer[4];
+
+          if (contents[i] != '\\')
+          {
+            scratch.append(1, contents[i]);
+            continue;
+          }
+          else if (++i >= contents.length())
+          {
+            return false;
+          }
+          switch (contents[i])
+          {
+            case 'b':
+              c = 010;
+              break;
+
+            case 't':
+              c = 011;
+              break;
+
+            case 'n':
+              c = 012;
+              break;
+
+            case 'f':
+              c = 014;
+              break;
+
+            case 'r':
+              c = 015;
+              break;
+
+            case '"':
+            case '\'':
+            case '\\':
+            case '/':
+              c = static_cast<char32_t>(contents[i]);
+              break;
+
+            case 'u':
+              if (contents.length() - i < 5)
+              {
+                return false;
+              }
+              for (int j = 0; j < 4; ++j)
+              {
+                const auto digit = contents[++i];
+
+                if (digit >= '0' && digit <= '9')
+                {
+                  c = c * 16 + (digit - '0');
+                }
+                else if (digit >= 'a' && digit <= 'f')
+                {
+                  c = c * 16 + (digit - 'a' + 10);
+                }
+                else if (digit >= 'A' && digit <= 'F')
+                {
+                  c = c * 16 + (digit - 'A' + 10);
+                } else {
+                  return false;
+                }
+              }
+              if (!is_unicode_scalar_value(c))
+              {
+                return false;
+              }
+              break;
+
+            default:
+              return false;
+          }
+          scratch.append(buffer, encode_utf8(c, buffer));
+        }
+        result = scratch;
+
+        return true;
+      }
+
+    private:
+      void skip_whitespace()
+      {
+        while (
+          m_current < m_end &&
+          (*m_current == ' ' || *m_current == '\t' ||
+           *m_current == '\r' || *m_current == '\n')
+        )
+        {
+          ++m_current;
+        }
+      }
+
+      inline bool peek_advance(char expected)
+      {
+        skip_whitespace();
+        if (m_current < m_end && *m_current == expected)
+        {
+          ++m_current;
+
+          return true;
+        }
+
+        return false;
+      }
+
+      /**
+       * Moves past string literal beginning at current position.
+       */
+      bool skip_string()
+      {
+        for (++m_current; m_current < m_end; ++m_current)
+        {
+          if (*m_current == '"')
+          {
+            ++m_current;
+
+            return true;
+          }
+          else if (*m_current == '\\')
+          {
+            ++m_current;
+          }
+        }
+
+        return false;
+      }
+
+      /**
+       * Moves past value beginning at current position. Arrays and objects
+       * are skipped by counting brackets, without looking at their contents
+       * otherwise.
+       */
+      bool skip_value()
+      {
+        std::size_t depth = 0;
+
+        if (m_current >= m_end)
+        {
+          return false;
+        }
+        do
+        {
+          const auto c = *m_current;
+
+          if (c == '"')
+          {
+            if (!skip_string())
+            {
+              return false;
+            }
+          }
+          else if (c == '[' || c == '{')
+          {
+            ++depth;
+            ++m_current;
+          }
+          else if (c == ']' || c == '}')
+          {
+            if (!depth--)
+            {
+              return false;
+            }
+            ++m_current;
+          }
+          else if (depth > 0)
+          {
+            ++m_current;
+          } else {
+            while (
+              m_current < m_end &&
+              std::strchr(",:]} \t\r\n", *m_current) == nullptr
+            )
+            {
+              ++m_current;
+            }
+          }
+        }
+        while (depth > 0 && m_current < m_end);
+
+        return depth == 0;
+      }
+
+      /**
+       * Moves into value of property with given name in object beginning at
+       * current position. If the name appears more than once, the last one
+       * is used, just like the parser does.
+       */
+      bool find_property(const std::string& name, std::string& scratch)
+      {
+        const char* found = nullptr;
+
+        if (!peek_advance('{'))
+        {
+          return false;
+        }
+        for (;;)
+        {
+          skip_whitespace();
+
+          const auto start = m_current;
+          std::string_view key;
+
+          if (
+            m_current >= m_end ||
+            *m_current != '"' ||
+            !skip_string() ||
+            !read_string(
+              std::string_view(
+                start,
+                static_cast<std::size_t>(m_current - start)
+              ),
+              key,
+              scratch
+            ) ||
+            !peek_advance(':')
+          )
+          {
+            return false;
+          }
+          skip_whitespace();
+          if (!key.compare(name))
+          {
+            found = m_current;
+          }
+          if (!skip_value())
+          {
+            return false;
+          }
+          else if (peek_advance('}'))
+          {
+            break;
+          }
+          else if (!peek_advance(','))
+          {
+            return false;
+          }
+        }
+        if (!found)
+        {
+          return false;
+        }
+        m_current = found;
+
+        return true;
+      }
+
+      const char* m_current;
+      const char* m_end;
+    };
+  }
+
+  /**
+   * Compiled filter which decides whether a record of UTF-8 encoded JSON
+   * matches given predicates directly from it's raw bytes, without parsing
+   * it. Records are first checked for presence of the property names and
+   * compared strings as substrings, which quickly rejects most of the
+   * records that cannot match. Remaining records are scanned only as far as
+   * needed for finding the values of the predicates, skipping everything
+   * else.
+   *
+   * Records which are not valid JSON may match or not, so matching records
+   * should still be parsed, as `filter_lines()` does.
+   */
+  class filter
+  {
+  public:
+    explicit filter(
+      const std::vector<filter_predicate>& predicates,
+      filter_mode mode = filter_mode::any
+    )
+      : m_mode(mode)
+    {
+      m_predicates.reserve(predicates.size());
+      for (const auto& predicate : predicates)
+      {
+        m_predicates.push_back(compile(predicate));
+      }
+    }
+
+    inline filter_mode mode() const
+    {
+      return m_mode;
+    }
+
+    /**
+     * Tests whether given record matches the filter.
+     */
+    bool matches(std::string_view record) const
+    {
+      // Without escape sequences, property names and strings must appear in
+      // the record exactly as they are.
+      const auto literal = record.find('\\') == std::string_view::npos;
+      std::string scratch;
+
+      for (const auto& predicate : m_predicates)
+      {
+        const auto result = (!literal || may_match(predicate, record))
+          && test(predicate, record, scratch);
+
+        if (result == (m_mode == filter_mode::any))
+        {
+          return result;
+        }
+      }
+
+      return m_mode == filter_mode::all;
+    }
+
+  private:
+    struct compiled_predicate
+    {
+      std::vector<std::string> path;
+      filter_operator op;
+      enum type type;
+      double number;
+      std::string string;
+      std::vector<std::string> needles;
+    };
+
+    static compiled_predicate compile(const filter_predicate& predicate)
+    {
+      compiled_predicate result;
+
+      result.op = predicate.op;
+      result.type = type_of(predicate.operand);
+      result.number = 0;
+      for (const auto& name : predicate.path)
+      {
+        result.path.push_back(internal::filter_utf8(name));
+        if (!needs_escape(result.path.back()))
+        {
+          result.needles.push_back('"' + result.path.back() + '"');
+        }
+      }
+      switch (result.type)
+      {
+        case type::boolean:
+          result.string = as_ref<boolean>(predicate.operand).value()
+            ? "true"
+            : "false";
+          break;
+
+        case type::null:
+          result.string = "null";
+          break;
+
+        case type::number:
+          result.number = as_ref<number>(predicate.operand).value();
+          break;
+
+        case type::string:
+          result.string = internal::filter_utf8(
+            as_ref<string>(predicate.operand).value()
+          );
+          if (
+            result.op == filter_operator::equal &&
+            !needs_escape(result.string)
+          )
+          {
+            result.needles.push_back(result.string);
+          }
+          break;
+
+        default:
+          break;
+      }
+      if (result.type == type::boolean || result.type == type::null)
+      {
+        result.needles.push_back(result.string);
+      }
+
+      return result;
+    }
+
+    static bool needs_escape(const std::string& input)
+    {
+      for (const auto c : input)
+      {
+        if (c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20)
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    static bool may_match(
+      const compiled_predicate& predicate,
+      std::string_view record
+    )
+    {
+      if (predicate.op == filter_operator::not_equal)
+      {
+        return true;
+      }
+      for (const auto& needle : predicate.needles)
+      {
+        if (record.find(needle) == std::string_view::npos)
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    static bool test(
+      const compiled_predicate& predicate,
+      std::string_view record,
+      std::string& scratch
+    )
+    {
+      internal::raw_scanner scanner(record);
+      std::string_view token;
+
+      if (
+        predicate.path.empty() ||
+        !scanner.find(predicate.path, token, scratch)
+      )
+      {
+        return false;
+      }
+
+      switch (predicate.type)
+      {
+        case type::boolean:
+        case type::null:
+          if (
+            predicate.op != filter_operator::equal &&
+            predicate.op != filter_operator::not_equal
+          )
+          {
+            return false;
+          }
+          else if (
+            predicate.type == type::boolean
+              ? token != "true" && token != "false"
+              : token != "null"
+          )
+          {
+            return false;
+          }
+
+          return internal::filter_compare(
+            predicate.op,
+            token,
+            std::string_view(predicate.string)
+          );
+
+        case type::number:
+          {
+            const auto last = token.data() + token.length();
+            double value;
+
+            if (
+              !(token[0] == '-' || (token[0] >= '0' && token[0] <= '9')) ||
+              token.find_first_not_of("0123456789+-.eE") !=
+                std::string_view::npos ||
+              !internal::parse_double(token.data(), last, value)
+            )
+            {
+              return false;
+            }
+
+            return internal::filter_compare(
+              predicate.op,
+              value,
+              predicate.number
+            );
+          }
+
+        case type::string:
+          {
+            std::string_view value;
+
+            return token.length() >= 2 && token[0] == '"' &&
+              internal::raw_scanner::read_string(token, value, scratch) &&
+              internal::filter_compare(
+                predicate.op,
+                value,
+                std::string_view(predicate.string)
+              );
+          }
+
+        default:
+          return false;
+      }
+    }
+
+    filter_mode m_mode;
+    std::vector<compiled_predicate> m_predicates;
+  };
+
+  /**
+   * Reads newline delimited JSON records from given input and parses only
+   * the records which match given filter. Each matching record is passed to
+   * the callback as a `parse_result`, with positions of parse errors
+   * reported using line numbers of the input. Empty lines are skipped.
+   * Returns false if reading from the input failed.
+   */
+  template<class Callback>
+  bool
+  filter_lines(
+    input& in,
+    const class filter& filter,
+    Callback callback,
+    const parse_options& options = parse_options()
+  )
+  {
+    char buffer[internal::input_reader::buffer_size];
+    std::string pending;
+    std::u32string source;
+    int line = 0;
+    const auto process = [&](std::string_view record)
+    {
+      ++line;
+      if (!record.empty() && record.back() == '\r')
+      {
+        record.remove_suffix(1);
+      }
+      if (record.empty() || !filter.matches(record))
+      {
+        return;
+      }
+      source.clear();
+      if (!internal::decode_utf8(
+        reinterpret_cast<const unsigned char*>(record.data()),
+        record.length(),
+        source
+      ))
+      {
+        callback(parse_result::error({
+          { line, 1 },
+          "Invalid UTF-8 input."
+        }));
+        return;
+      }
+      callback(parse(source, options, line));
+    };
+
+    for (;;)
+    {
+      const auto size = in.read(buffer, sizeof(buffer));
+      std::string_view chunk(buffer, size);
+
+      if (!size)
+      {
+        break;
+      }
+      for (auto newline = chunk.find('\n');
+           newline != std::string_view::npos;
+           newline = chunk.find('\n'))
+      {
+        if (pending.empty())
+        {
+          process(chunk.substr(0, newline));
+        } else {
+          pending.append(chunk.substr(0, newline));
+          process(pending);
+          pending.clear();
+        }
+        chunk.remove_prefix(newline + 1);
+      }
+      pending.append(chunk);
+    }
+    if (!pending.empty())
+    {
+      process(pending);
+    }
+
+    return !in.failed();
+  }
+}
@@ -25,80 +25,774 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
+#include <peelo/json/source_map.hpp>
+#include <peelo/json/utf8.hpp>
 #include <peelo/json/visitor.hpp>
 
 namespace peelo::json
 {
+  /**
+   * Abstract destination for formatted JSON. Formatter writes it's output
+   * into a sink in chunks as it's internal buffer fills, so the whole output
+   * never needs to be held in memory at once.
+   */
+  class sink
+  {
+  public:
+    virtual void
+    write(const char* data, std::size_t size) = 0;
+  };
+
+  /**
+   * Sink that writes into an output stream.
+   */
+  class ostream_sink final : public sink
+  {
+  public:
+    explicit ostream_sink(std::ostream& stream)
+      : m_stream(stream) {}
+
+    void write(const char* data, std::size_t size)
+    {
+      m_stream.write(data, static_cast<std::streamsize>(size));
+    }
+
+  private:
+    std::ostream& m_stream;
+  };
+
+  /**
+   * Sink that writes into a C standard library file handle.
+   */
+  class file_sink final : public sink
+  {
+  public:
+    explicit file_sink(std::FILE* file)
+      : m_file(file) {}
+
+    void write(const char* data, std::size_t size)
+    {
+      std::fwrite(data, 1, size, m_file);
+    }
+
+  private:
+    std::FILE* m_file;
+  };
+
+  /**
+   * Sink that writes into a raw file descriptor, such as a pipe or a socket.
+   * Once a write fails, rest of the output is discarded.
+   */
+  class fd_sink final : public sink
+  {
+  public:
+    explicit fd_sink(int fd)
+      : m_fd(fd)
+      , m_failed(false) {}
+
+    /**
+     * Returns true if writing into the file descriptor has failed.
+     */
+    inline bool failed() const
+    {
+      return m_failed;
+    }
+
+    void write(const char* data, std::size_t size)
+    {
+      while (size > 0 && !m_failed)
+      {
+#if defined(_WIN32)
+        const auto written = ::_write(
+          m_fd,
+          data,
+          static_cast<unsigned int>(size)
+        );
+#else
+        const auto written = ::write(m_fd, data, size);
+#endif
+
+        if (written < 0)
+        {
+          if (errno != EINTR)
+          {
+            m_failed = true;
+          }
+          continue;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+      }
+    }
+
+  private:
+    int m_fd;
+    bool m_failed;
+  };
+
+  /**
+   * Sink that passes each chunk of output to an user supplied callback.
+   */
+  class callback_sink final : public sink
+  {
+  public:
+    using callback_type = std::function<void(const char*, std::size_t)>;
+
+    explicit callback_sink(const callback_type& callback)
+      : m_callback(callback) {}
+
+    void write(const char* data, std::size_t size)
+    {
+      m_callback(data, size);
+    }
+
+  private:
+    const callback_type m_callback;
+  };
+
+  /**
+   * Enumeration of different encodings for formatted JSON.
+   */
+  enum class format_encoding
+  {
+    /**
+     * Output consists only of ASCII characters. Everything else is escaped,
+     * code points outside of the Basic Multilingual Plane as surrogate pairs.
+     */
+    ascii = 0,
+    /**
+     * Output is encoded in UTF-8 and only the characters which JSON requires
+     * are escaped.
+     */
+    utf8 = 1,
+  };
+
+  /**
+   * Options for formatting JSON values.
+   */
+  struct format_options
+  {
+    enum format_encoding encoding = format_encoding::ascii;
+
+    /**
+     * Whether properties of objects are output sorted by their keys, in
+     * Unicode code point order. Combined with the shortest round trip number
+     * formatting, this produces canonical output where equal values are
+     * always formatted the same way.
+     */
+    bool sort_keys = false;
+
+    /**
+     * Optional map of source code the values were parsed from. Values found
+     * in the map are output by copying their original source code, instead
+     * of formatting them again. Ignored when `sort_keys` is set, since the
+     * source code might not have the properties in sorted order.
+     */
+    const source_map* sources = nullptr;
+  };
+
+  /**
+   * Cache of formatted output of arrays and objects. Since values are
+   * immutable, output of a subtree never changes, so when the same subtree
+   * is formatted again, it's output can be copied from the cache instead.
+   *
+   * Subtrees are cached when they are formatted with the cache, if they are
+   * shared, e.g. referenced from more than one place, and their output is at
+   * least `min_size` bytes long. The value given to the formatter itself,
+   * such as root of an one-off response, and subtrees which are not shared
+   * are unlikely to be formatted again, so they are only cached with
+   * `precompute()`. Total size of the cached output
+   * is bounded by `max_size`, and least recently used entries are evicted
+   * when it would be exceeded. The cache is safe to use from multiple
+   * threads.
+   *
+   * The cache does not keep the values alive, but it refers to them with
+   * weak pointers, which keeps the memory of values created with
+   * `std::make_shared()` or `std::allocate_shared()` allocated until the
+   * entry is evicted. Values allocated from a memory resource must therefore
+   * not be cached beyond lifetime of the memory resource. With intrusive
+   * reference counting the cache holds the values themselves until they
+   * are found to be expired, and it must not be shared between threads.
+   */
+  class format_cache
+  {
+  public:
+    using bytes_type = std::shared_ptr<const std::string>;
+
+    explicit format_cache(
+      const format_options& options = format_options(),
+      std::size_t max_size = 16 * 1024 * 1024,
+      std::size_t min_size = 64
+    )
+      : m_options(options)
+      , m_max_size(max_size)
+      , m_min_size(min_size)
+      , m_size(0) {}
+
+    format_cache(const format_cache&) = delete;
+    format_cache(format_cache&&) = delete;
+    void operator=(const format_cache&) = delete;
+    void operator=(format_cache&&) = delete;
+
+    /**
+     * Returns the options which are used when formatting with this cache.
+     */
+    inline const format_options& options() const
+    {
+      return m_options;
+    }
+
+    /**
+     * Returns total size of the cached output in bytes.
+     */
+    inline std::size_t size() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      return m_size;
+    }
+
+    /**
+     * Returns number of cached subtrees.
+     */
+    inline std::size_t count() const
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      return m_entries.size();
+    }
+
+    /**
+     * Formats given value and stores it's output in the cache, regardless of
+     * it's size.
+     */
+    void precompute(const value& v);
+
+    /**
+     * Returns cached output of given value, or null pointer if the value is
+     * not in the cache.
+     */
+    bytes_type find(const value& v)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto it = m_index.find(v.get());
+
+      if (it == std::end(m_index))
+      {
+        return nullptr;
+      }
+      else if (it->second->expired())
+      {
+        remove(it->second);
+
+        return nullptr;
+      }
+      m_entries.splice(std::begin(m_entries), m_entries, it->second);
+
+      return it->second->bytes;
+    }
+
+    /**
+     * Stores output of given value in the cache. Output shorter than the
+     * minimum size is only stored if `force` is true.
+     */
+    void insert(const value& v, std::string bytes, bool force = false)
+    {
+      const auto size = bytes.length();
+
+      if (!v || size > m_max_size || (!force && size < m_min_size))
+      {
+        return;
+      }
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      const auto it = m_index.find(v.get());
+
+      if (it != std::end(m_index))
+      {
+        remove(it->second);
+      }
+      while (m_size + size > m_max_size)
+      {
+        remove(std::prev(std::end(m_entries)));
+      }
+      m_entries.push_front({
+        v.get(),
+        v,
+        std::make_shared<const std::string>(std::move(bytes))
+      });
+      m_index[v.get()] = std::begin(m_entries);
+      m_size += size;
+    }
+
+    /**
+     * Removes entries of values which no longer exist from the cache.
+     */
+    void purge()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (auto it = std::begin(m_entries); it != std::end(m_entries);)
+      {
+        if (it->expired())
+        {
+          remove(it++);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    /**
+     * Removes all entries from the cache.
+     */
+    void clear()
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      m_entries.clear();
+      m_index.clear();
+      m_size = 0;
+    }
+
+  private:
+    struct entry
+    {
+      const internal::base* key;
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      // Intrusive pointers cannot be weak, so the entry keeps the value
+      // alive and treats it as expired once nothing else refers to it.
+      value node;
+#else
+      std::weak_ptr<internal::base> node;
+#endif
+      bytes_type bytes;
+
+      inline bool expired() const
+      {
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+        return node.use_count() <= 1;
+#else
+        return node.expired();
+#endif
+      }
+    };
+    using entry_list = std::list<entry>;
+
+    void remove(entry_list::iterator it)
+    {
+      m_size -= it->bytes->length();
+      m_index.erase(it->key);
+      m_entries.erase(it);
+    }
+
+  private:
+    const format_options m_options;
+    const std::size_t m_max_size;
+    const std::size_t m_min_size;
+    mutable std::mutex m_mutex;
+    std::size_t m_size;
+    entry_list m_entries;
+    std::unordered_map<const internal::base*, entry_list::iterator> m_index;
+  };
+
   namespace internal
   {
-    class formatter final : public visitor
+    /**
+     * Formatter output which appends into a string.
+     */
+    class string_output
+    {
+    public:
+      explicit string_output(std::string& result)
+        : m_result(result) {}
+
+      inline void append(char c)
+      {
+        m_result.append(1, c);
+      }
+
+      inline void append(const char* data, std::size_t size)
+      {
+        m_result.append(data, size);
+      }
+
+    private:
+      std::string& m_result;
+    };
+
+    /**
+     * Formatter output which only counts the length of the output. Used for
+     * computing exact size of the output before writing it.
+     */
+    class counting_output
+    {
+    public:
+      explicit counting_output()
+        : m_size(0) {}
+
+      inline std::size_t size() const
+      {
+        return m_size;
+      }
+
+      inline void append(char)
+      {
+        ++m_size;
+      }
+
+      inline void append(const char*, std::size_t size)
+      {
+        m_size += size;
+      }
+
+    private:
+      std::size_t m_size;
+    };
+
+    /**
+     * Formatter output which collects output into a fixed size buffer and
+     * flushes it into a sink whenever the buffer fills up. Remaining output
+     * must be flushed explicitly, because sinks may throw and therefore the
+     * destructor does not write anything.
+     */
+    class buffered_output
+    {
+    public:
+      static constexpr std::size_t buffer_size = 4096;
+
+      explicit buffered_output(class sink& sink)
+        : m_sink(sink)
+        , m_size(0) {}
+
+      buffered_output(const buffered_output&) = delete;
+      buffered_output(buffered_output&&) = delete;
+      void operator=(const buffered_output&) = delete;
+      void operator=(buffered_output&&) = delete;
+
+      inline void append(char c)
+      {
+        if (m_size == buffer_size)
+        {
+          flush();
+        }
+        m_buffer[m_size++] = c;
+      }
+
+      void append(const char* data, std::size_t size)
+      {
+        if (m_size + size > buffer_size)
+        {
+          flush();
+          if (size > buffer_size)
+          {
+            m_sink.write(data, size);
+
+            return;
+          }
+        }
+        std::memcpy(m_buffer + m_size, data, size);
+        m_size += size;
+      }
+
+      void flush()
+      {
+        if (m_size > 0)
+        {
+          m_sink.write(m_buffer, m_size);
+          m_size = 0;
+        }
+      }
+
+    private:
+      class sink& m_sink;
+      std::size_t m_size;
+      char m_buffer[buffer_size];
+    };
+
+    /**
+     * Formatter output which writes into a fixed size buffer, discarding
+     * everything that does not fit in it while still counting the length of
+     * the whole output.
+     */
+    class bounded_output
     {
     public:
-      formatter() = default;
-      formatter(const formatter&) = default;
-      formatter(formatter&&) = default;
-      formatter& operator=(const formatter&) = default;
-      formatter& operator=(formatter&&) = default;
+      explicit bounded_output(char* buffer, std::size_t capacity)
+        : m_buffer(buffer)
+        , m_capacity(capacity)
+        , m_size(0) {}
+
+      inline std::size_t size() const
+      {
+        return m_size;
+      }
+
+      inline void append(char c)
+      {
+        if (m_size < m_capacity)
+        {
+          m_buffer[m_size] = c;
+        }
+        ++m_size;
+      }
+
+      void append(const char* data, std::size_t size)
+      {
+        if (m_size < m_capacity)
+        {
+          std::memcpy(
+            m_buffer + m_size,
+            data,
+            std::min(size, m_capacity - m_size)
+          );
+        }
+        m_size += size;
+      }
+
+    private:
+      char* m_buffer;
+      const std::size_t m_capacity;
+      std::size_t m_size;
+    };
 
-      inline const std::string& result() const
+    /**
+     * Lookup table for ASCII characters which need to be escaped in JSON
+     * strings. Zero means that the character can be output as it is, `u` that
+     * it's output as an Unicode escape sequence and anything else is the
+     * character which follows the backslash in the escape sequence.
+     */
+    inline constexpr char escape_table[128] =
+    {
+      'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+      'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+      'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+      'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+      0, 0, '"', 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, '/',
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, '\\', 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 'u',
+    };
+
+    inline constexpr char hex_digits[] = "0123456789abcdef";
+
+    /**
+     * Number of characters tested at once when scanning for characters that
+     * need to be escaped.
+     */
+    inline constexpr std::size_t clean_block_size = 16;
+
+    /**
+     * Determines whether given character can be output as it is. In ASCII
+     * mode only printable ASCII characters can, while in UTF-8 mode
+     * everything else than control characters, quotes, backslashes and
+     * invalid code points can.
+     */
+    template<bool Ascii>
+    inline bool
+    is_clean(char32_t c)
+    {
+      if constexpr (Ascii)
       {
-        return m_result;
+        return c < 128 && !escape_table[c];
+      } else {
+        return c >= 0x20
+          && c != '"'
+          && c != '\\'
+          && is_unicode_scalar_value(c);
       }
+    }
+
+    /**
+     * Determines whether given block consists only of ASCII characters that
+     * do not need to be escaped. The loop has no branches and no table
+     * lookups, so that the compiler can vectorize it.
+     */
+    template<bool Ascii>
+    inline bool
+    is_clean_block(const char32_t* data)
+    {
+      bool dirty = false;
+
+      for (std::size_t i = 0; i < clean_block_size; ++i)
+      {
+        const auto c = data[i];
+
+        if constexpr (Ascii)
+        {
+          dirty |= (c - 0x20) > 0x5e || c == '"' || c == '\\' || c == '/';
+        } else {
+          dirty |= (c - 0x20) > 0x5f || c == '"' || c == '\\';
+        }
+      }
+
+      return !dirty;
+    }
+
+    /**
+     * Returns pointers to properties of given object, sorted by their keys.
+     */
+    inline std::vector<const object::value_type*>
+    sorted_properties(const object::container_type& properties)
+    {
+      std::vector<const object::value_type*> result;
+
+      result.reserve(properties.size());
+      for (const auto& property : properties)
+      {
+        result.push_back(&property);
+      }
+      std::sort(
+        std::begin(result),
+        std::end(result),
+        [](const object::value_type* a, const object::value_type* b)
+        {
+          return a->first < b->first;
+        }
+      );
+
+      return result;
+    }
+
+    /**
+     * Formatter is used with statically dispatched `accept()`, so none of
+     * it's methods are virtual.
+     */
+    template<class Output>
+    class formatter final
+    {
+    public:
+      explicit formatter(
+        Output& output,
+        const format_options& options,
+        format_cache* cache = nullptr
+      )
+        : m_output(output)
+        , m_options(options)
+        , m_cache(cache)
+        , m_capture(nullptr)
+        , m_nested(false) {}
 
       void visit_array(const array::container_type& elements)
       {
         bool first = true;
 
-        m_result.append(1, '[');
+        append('[');
         for (const auto& element : elements)
         {
           if (first)
           {
             first = false;
           } else {
-            m_result.append(1, ',');
+            append(',');
           }
-          accept(*this, element);
+          output_value(element);
         }
-        m_result.append(1, ']');
+        append(']');
       }
 
       void visit_boolean(bool value)
       {
-        m_result.append(value ? "true" : "false");
+        if (value)
+        {
+          append("true", 4);
+        } else {
+          append("false", 5);
+        }
       }
 
       void visit_null()
       {
-        m_result.append("null");
+        append("null", 4);
       }
 
       void visit_number(double value)
       {
+        // Largest integer below which all integers are exactly representable
+        // as double.
+        static constexpr double max_exact_integer = 9007199254740992.0;
         char buffer[32];
+        std::to_chars_result result;
+
+        // JSON has no representation for infinities or NaN.
+        if (!std::isfinite(value))
+        {
+          append("null", 4);
+
+          return;
+        }
+
+        // Fast path for whole numbers, which are far more common than
+        // fractions. Negative zero goes through the slow path to keep it's
+        // sign.
+        if (
+          std::fabs(value) < max_exact_integer &&
+          std::trunc(value) == value &&
+          (value != 0.0 || !std::signbit(value))
+        )
+        {
+          result = std::to_chars(
+            buffer,
+            buffer + sizeof(buffer),
+            static_cast<std::int64_t>(value)
+          );
+        } else {
+          // Shortest representation which converts back to the same value.
+          result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        }
 
-        std::snprintf(buffer, sizeof(buffer), "%g", value);
-        m_result.append(buffer);
+        append(buffer, static_cast<std::size_t>(result.ptr - buffer));
       }
 
       void visit_object(const object::container_type& properties)
       {
         bool first = true;
 
-        m_result.append(1, '{');
-        for (const auto& property : properties)
+        append('{');
+        if (m_options.sort_keys)
         {
-          if (first)
+          for (const auto property : sorted_properties(properties))
           {
-            first = false;
-          } else {
-            m_result.append(1, ',');
+            output_property(*property, first);
+          }
+        } else {
+          for (const auto& property : properties)
+          {
+            output_property(property, first);
           }
-          output_string(property.first);
-          m_result.append(1, ':');
-          accept(*this, property.second);
         }
-        m_result.append(1, '}');
+        append('}');
       }
 
       void visit_string(const string::value_type& value)
@@ -106,76 +800,415 @@ namespace peelo::json
         output_string(value);
       }
 
+      /**
+       * Outputs given value, copying its original source code from the
+       * source map or the output of arrays and objects from the cache when
+       * those are used.
+       */
+      void output_value(const value& v)
+      {
+        const auto t = type_of(v);
+        const auto root = !m_nested;
+
+        m_nested = true;
+
+        if (m_options.sources && !m_options.sort_keys)
+        {
+          if (const auto text = m_options.sources->text(v); !text.empty())
+          {
+            if (m_options.encoding == format_encoding::utf8)
+            {
+              output_source<false>(text);
+            } else {
+              output_source<true>(text);
+            }
+
+            return;
+          }
+        }
+        if (t == type::number)
+        {
+          output_number(as_ref<number>(v));
+        }
+        else if (!m_cache || (t != type::array && t != type::object))
+        {
+          accept(*this, v);
+        }
+        else if (const auto bytes = m_cache->find(v))
+        {
+          append(bytes->data(), bytes->length());
+        }
+        else if (root || m_capture || v.use_count() <= 1)
+        {
+          accept(*this, v);
+        } else {
+          std::string result;
+
+          // Output is captured while it's written, so that it's formatted
+          // only once. Shared subtrees nested inside are not captured
+          // separately.
+          m_capture = &result;
+          accept(*this, v);
+          m_capture = nullptr;
+          m_cache->insert(v, std::move(result));
+        }
+      }
+
     private:
-      void output_string(const string::value_type& value)
+      inline void append(char c)
+      {
+        m_output.append(c);
+        if (m_capture)
+        {
+          m_capture->append(1, c);
+        }
+      }
+
+      inline void append(const char* data, std::size_t size)
+      {
+        m_output.append(data, size);
+        if (m_capture)
+        {
+          m_capture->append(data, size);
+        }
+      }
+
+      /**
+       * Outputs integers exactly and numbers parsed from decimal digits with
+       * their original digits, unless canonical output with sorted keys is
+       * requested.
+       */
+      void output_number(const number& n)
+      {
+        char buffer[32];
+        std::to_chars_result result;
+
+        switch (n.kind())
+        {
+          case number::kind::int64:
+            result = std::to_chars(
+              buffer,
+              buffer + sizeof(buffer),
+              *n.as_int64()
+            );
+            break;
+
+          case number::kind::uint64:
+            result = std::to_chars(
+              buffer,
+              buffer + sizeof(buffer),
+              *n.as_uint64()
+            );
+            break;
+
+          case number::kind::digits:
+            if (!m_options.sort_keys)
+            {
+              const auto digits = n.digits();
+
+              append(digits.data(), digits.length());
+
+              return;
+            }
+            [[fallthrough]];
+
+          default:
+            visit_number(n.value());
+
+            return;
+        }
+
+        append(buffer, static_cast<std::size_t>(result.ptr - buffer));
+      }
+
+      void output_property(const object::value_type& property, bool& first)
       {
-        m_result.append(1, '"');
-        for (const auto& c : value)
+        if (first)
         {
-          switch (c)
+          first = false;
+        } else {
+          append(',');
+        }
+        output_string(property.first);
+        append(':');
+        output_value(property.second);
+      }
+
+      void output_string(std::u32string_view value)
+      {
+        if (m_options.encoding == format_encoding::ascii)
+        {
+          output_string<true>(value);
+        } else {
+          output_string<false>(value);
+        }
+      }
+
+      template<bool Ascii>
+      void output_string(std::u32string_view value)
+      {
+        const auto data = value.data();
+        const auto size = value.size();
+        std::size_t offset = 0;
+
+        append('"');
+        while (offset < size)
+        {
+          auto run_end = offset;
+
+          while (
+            run_end + clean_block_size <= size &&
+            is_clean_block<Ascii>(data + run_end)
+          )
+          {
+            run_end += clean_block_size;
+          }
+          while (run_end < size && is_clean<Ascii>(data[run_end]))
+          {
+            ++run_end;
+          }
+          output_run<Ascii>(data + offset, run_end - offset);
+          if (run_end < size)
+          {
+            output_escape(data[run_end++]);
+          }
+          offset = run_end;
+        }
+        append('"');
+      }
+
+      /**
+       * Outputs run of characters which do not need to be escaped in bulk.
+       */
+      template<bool Ascii>
+      void output_run(const char32_t* data, std::size_t size)
+      {
+        char buffer[256];
+        std::size_t length = 0;
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+          if (length + 4 > sizeof(buffer))
+          {
+            append(buffer, length);
+            length = 0;
+          }
+          if constexpr (Ascii)
+          {
+            buffer[length++] = static_cast<char>(data[i]);
+          } else {
+            length += encode_utf8(data[i], buffer + length);
+          }
+        }
+        append(buffer, length);
+      }
+
+      /**
+       * Outputs source code of a value as it is, except for non-ASCII
+       * characters which are escaped in ASCII mode. Those can only appear
+       * inside strings in valid JSON.
+       */
+      template<bool Ascii>
+      void output_source(std::u32string_view text)
+      {
+        char buffer[256];
+        std::size_t length = 0;
+
+        for (const auto c : text)
+        {
+          if (length + 4 > sizeof(buffer))
+          {
+            append(buffer, length);
+            length = 0;
+          }
+          if (c < 128)
+          {
+            buffer[length++] = static_cast<char>(c);
+          }
+          else if (!Ascii && is_unicode_scalar_value(c))
           {
-            case 010:
-              m_result.append(1, '\\');
-              m_result.append(1, 'b');
-              break;
-
-            case 011:
-              m_result.append(1, '\\');
-              m_result.append(1, 't');
-              break;
-
-            case 012:
-              m_result.append(1, '\\');
-              m_result.append(1, 'n');
-              break;
-
-            case 014:
-              m_result.append(1, '\\');
-              m_result.append(1, 'f');
-              break;
-
-            case 015:
-              m_result.append(1, '\\');
-              m_result.append(1, 'r');
-              break;
-
-            case '"':
-            case '\\':
-            case '/':
-              m_result.append(1, '\\');
-              m_result.append(1, static_cast<char>(c));
-              break;
-
-            default:
-              if (!std::isprint(c))
-              {
-                char buffer[7];
-
-                std::snprintf(buffer, 7, "\\u%04x", static_cast<int>(c));
-                m_result.append(buffer);
-              } else {
-                m_result.append(1, static_cast<char>(c));
-              }
+            length += encode_utf8(c, buffer + length);
+          } else {
+            append(buffer, length);
+            length = 0;
+            output_escape(c);
           }
         }
-        m_result.append(1, '"');
+        append(buffer, length);
+      }
+
+      void output_escape(char32_t c)
+      {
+        if (c < 128 && escape_table[c] != 'u')
+        {
+          const char buffer[2] = { '\\', escape_table[c] };
+
+          append(buffer, 2);
+        }
+        else if (c > 0x10ffff)
+        {
+          // Not representable in JSON, so output replacement character.
+          output_unicode_escape(0xfffd);
+        }
+        else if (c > 0xffff)
+        {
+          c -= 0x10000;
+          output_unicode_escape(0xd800 + (c >> 10));
+          output_unicode_escape(0xdc00 + (c & 0x3ff));
+        } else {
+          output_unicode_escape(c);
+        }
+      }
+
+      void output_unicode_escape(char32_t c)
+      {
+        const char buffer[6] =
+        {
+          '\\',
+          'u',
+          hex_digits[(c >> 12) & 0xf],
+          hex_digits[(c >> 8) & 0xf],
+          hex_digits[(c >> 4) & 0xf],
+          hex_digits[c & 0xf],
+        };
+
+        append(buffer, 6);
       }
 
     private:
-      std::string m_result;
+      Output& m_output;
+      const format_options& m_options;
+      format_cache* m_cache;
+      std::string* m_capture;
+      bool m_nested;
     };
   }
 
   /**
-   * Converts given JSON value into ASCII string.
+   * Computes exact length of the output that formatting given JSON value
+   * with given options produces. Can be used for allocating a buffer for
+   * `format_to()` function.
+   */
+  inline std::size_t
+  formatted_size(
+    const value& v,
+    const format_options& options = format_options()
+  )
+  {
+    internal::counting_output output;
+    internal::formatter<internal::counting_output> fmt(output, options);
+
+    fmt.output_value(v);
+
+    return output.size();
+  }
+
+  /**
+   * Converts given JSON value into string, encoded as specified in the
+   * options.
    */
   inline std::string
-  format(const value& v)
+  format(const value& v, const format_options& options = format_options())
+  {
+    std::string result;
+    internal::string_output output(result);
+    internal::formatter<internal::string_output> fmt(output, options);
+
+    fmt.output_value(v);
+
+    return result;
+  }
+
+  /**
+   * Converts given JSON value into string with the options of given cache.
+   * Output of arrays and objects is copied from the cache when they are
+   * found in it, and stored into it when they are not.
+   */
+  inline std::string
+  format(const value& v, format_cache& cache)
+  {
+    std::string result;
+    internal::string_output output(result);
+    internal::formatter<internal::string_output> fmt(
+      output,
+      cache.options(),
+      &cache
+    );
+
+    fmt.output_value(v);
+
+    return result;
+  }
+
+  inline void
+  format_cache::precompute(const value& v)
+  {
+    const auto t = type_of(v);
+
+    if (t == type::array || t == type::object)
+    {
+      insert(v, format(v, *this), true);
+    }
+  }
+
+  /**
+   * Converts given JSON value into string and writes it into given sink. The
+   * output is buffered in fixed size chunks which are passed to the sink as
+   * they fill up, so memory usage does not depend on the size of the output.
+   */
+  inline void
+  format_to(
+    class sink& sink,
+    const value& v,
+    const format_options& options = format_options()
+  )
+  {
+    internal::buffered_output output(sink);
+    internal::formatter<internal::buffered_output> fmt(output, options);
+
+    fmt.output_value(v);
+    output.flush();
+  }
+
+  /**
+   * Converts given JSON value into string with the options of given cache
+   * and writes it into given sink.
+   */
+  inline void
+  format_to(class sink& sink, const value& v, format_cache& cache)
+  {
+    internal::buffered_output output(sink);
+    internal::formatter<internal::buffered_output> fmt(
+      output,
+      cache.options(),
+      &cache
+    );
+
+    fmt.output_value(v);
+    output.flush();
+  }
+
+  /**
+   * Converts given JSON value into string and writes it into given fixed size
+   * buffer. Output that does not fit into the buffer is discarded and the
+   * buffer is not terminated with a NUL character.
+   *
+   * Returns length of the whole output, which is greater than size of the
+   * buffer if the output was truncated.
+   */
+  inline std::size_t
+  format_to(
+    char* buffer,
+    std::size_t size,
+    const value& v,
+    const format_options& options = format_options()
+  )
   {
-    internal::formatter fmt;
+    internal::bounded_output output(buffer, size);
+    internal::formatter<internal::bounded_output> fmt(output, options);
 
-    accept(fmt, v);
+    fmt.output_value(v);
 
-    return fmt.result();
+    return output.size();
   }
 }
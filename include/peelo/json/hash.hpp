@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <string_view>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    inline std::size_t
+    mix_hash(std::size_t seed, std::size_t value)
+    {
+      constexpr auto golden_ratio = static_cast<std::size_t>(
+        0x9e3779b97f4a7c15ULL
+      );
+
+      return seed ^ (value + golden_ratio + (seed << 6) + (seed >> 2));
+    }
+
+    inline std::size_t
+    hash_string(std::u32string_view value)
+    {
+      return std::hash<std::u32string_view>()(value);
+    }
+
+    inline std::size_t
+    hash_number(double value)
+    {
+      // Negative and positive zero are equal, so they must have same hash.
+      return std::hash<double>()(value == 0.0 ? 0.0 : value);
+    }
+  }
+
+  /**
+   * Computes structural hash of given JSON value. Equal values always have
+   * equal hashes, regardless of the order of properties in objects.
+   *
+   * If `cache` is true, hashes of arrays, objects and strings are stored in
+   * the values themselves, so hashing the same subtree again is a constant
+   * time operation.
+   */
+  inline std::size_t
+  hash(const value& v, bool cache = true)
+  {
+    const auto t = type_of(v);
+    std::size_t result;
+
+    if (t == type::null)
+    {
+      return internal::mix_hash(0, static_cast<std::size_t>(t));
+    }
+    else if (t == type::boolean)
+    {
+      return internal::mix_hash(as_ref<boolean>(v).value() ? 1 : 2, 1);
+    }
+    else if (t == type::number)
+    {
+      return internal::mix_hash(
+        internal::hash_number(as_ref<number>(v).value()),
+        static_cast<std::size_t>(t)
+      );
+    }
+    else if ((result = v->cached_hash()))
+    {
+      return result;
+    }
+
+    result = static_cast<std::size_t>(t);
+    if (t == type::array)
+    {
+      for (const auto& element : as_ref<array>(v).elements())
+      {
+        result = internal::mix_hash(result, hash(element, cache));
+      }
+    }
+    else if (t == type::object)
+    {
+      std::size_t properties = 0;
+
+      // Properties are combined with addition, so that their order does not
+      // affect the result.
+      for (const auto& property : as_ref<object>(v).properties())
+      {
+        properties += internal::mix_hash(
+          internal::hash_string(property.first),
+          hash(property.second, cache)
+        );
+      }
+      result = internal::mix_hash(result, properties);
+    } else {
+      result = internal::mix_hash(
+        result,
+        internal::hash_string(as_ref<string>(v).value())
+      );
+    }
+
+    // Zero is reserved for hashes which have not been computed yet.
+    if (!result)
+    {
+      result = 1;
+    }
+    if (cache)
+    {
+      v->cache_hash(result);
+    }
+
+    return result;
+  }
+
+  /**
+   * Tests whether two JSON values are structurally equal. Values which are
+   * the same node are detected without comparing their contents and values
+   * whose hashes have already been cached are compared by their hashes
+   * first.
+   */
+  inline bool
+  equals(const value& a, const value& b)
+  {
+    const auto t = type_of(a);
+
+    if (a == b)
+    {
+      return true;
+    }
+    else if (t != type_of(b))
+    {
+      return false;
+    }
+
+    switch (t)
+    {
+      case type::boolean:
+        return as_ref<boolean>(a).value() == as_ref<boolean>(b).value();
+
+      case type::null:
+        return true;
+
+      case type::number:
+        {
+          const auto& x = as_ref<number>(a);
+          const auto& y = as_ref<number>(b);
+
+          // Integers are compared exactly, as converting them into double
+          // might lose precision.
+          if (
+            x.kind() != number::kind::floating &&
+            x.kind() != number::kind::digits &&
+            y.kind() != number::kind::floating &&
+            y.kind() != number::kind::digits
+          )
+          {
+            if (x.kind() != y.kind())
+            {
+              return false;
+            }
+
+            return x.kind() == number::kind::int64
+              ? x.as_int64() == y.as_int64()
+              : x.as_uint64() == y.as_uint64();
+          }
+
+          return x.value() == y.value();
+        }
+
+      default:
+        break;
+    }
+
+    if (a->cached_hash() && b->cached_hash())
+    {
+      if (a->cached_hash() != b->cached_hash())
+      {
+        return false;
+      }
+    }
+
+    if (t == type::array)
+    {
+      const auto& x = as_ref<array>(a).elements();
+      const auto& y = as_ref<array>(b).elements();
+
+      if (x.size() != y.size())
+      {
+        return false;
+      }
+      for (std::size_t i = 0; i < x.size(); ++i)
+      {
+        if (!equals(x[i], y[i]))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+    else if (t == type::object)
+    {
+      const auto& x = as_ref<object>(a).properties();
+      const auto& y = as_ref<object>(b).properties();
+
+      if (x.size() != y.size())
+      {
+        return false;
+      }
+      for (const auto& property : x)
+      {
+        const auto it = y.find(property.first);
+
+        if (it == std::end(y) || !equals(property.second, it->second))
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    return !as_ref<string>(a).value().compare(as_ref<string>(b).value());
+  }
+
+  /**
+   * Hash function object for using JSON values as keys of unordered
+   * containers.
+   */
+  struct value_hash
+  {
+    inline std::size_t operator()(const value& v) const
+    {
+      return hash(v);
+    }
+  };
+
+  /**
+   * Equality function object for using JSON values as keys of unordered
+   * containers.
+   */
+  struct value_equal
+  {
+    inline bool operator()(const value& a, const value& b) const
+    {
+      return equals(a, b);
+    }
+  };
+}
@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <vector>
+
+#include <peelo/json/binary.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    /**
+     * Writes given prefix followed by given value in given number of bytes.
+     */
+    inline void
+    msgpack_write(
+      std::vector<std::uint8_t>& output,
+      std::uint8_t prefix,
+      std::uint64_t value,
+      std::size_t bytes
+    )
+    {
+      output.push_back(prefix);
+      write_big_endian(output, value, bytes);
+    }
+
+    /**
+     * Writes head of a string, array or map, which has short form for
+     * lengths less than `fix_limit`.
+     */
+    inline void
+    msgpack_write_length(
+      std::vector<std::uint8_t>& output,
+      std::size_t length,
+      std::uint8_t fix_prefix,
+      std::size_t fix_limit,
+      std::uint8_t prefix8,
+      std::uint8_t prefix16,
+      std::uint8_t prefix32
+    )
+    {
+      if (length < fix_limit)
+      {
+        output.push_back(fix_prefix | static_cast<std::uint8_t>(length));
+      }
+      else if (length <= 0xff && prefix8)
+      {
+        msgpack_write(output, prefix8, length, 1);
+      }
+      else if (length <= 0xffff)
+      {
+        msgpack_write(output, prefix16, length, 2);
+      } else {
+        msgpack_write(output, prefix32, length, 4);
+      }
+    }
+
+    inline void
+    msgpack_write_string(
+      std::vector<std::uint8_t>& output,
+      std::u32string_view value
+    )
+    {
+      msgpack_write_length(
+        output,
+        utf8_length(value),
+        0xa0,
+        32,
+        0xd9,
+        0xda,
+        0xdb
+      );
+      write_utf8(output, value);
+    }
+
+    inline void
+    msgpack_write_unsigned(std::vector<std::uint8_t>& output, std::uint64_t u)
+    {
+      if (u < 0x80)
+      {
+        output.push_back(static_cast<std::uint8_t>(u));
+      }
+      else if (u <= 0xff)
+      {
+        msgpack_write(output, 0xcc, u, 1);
+      }
+      else if (u <= 0xffff)
+      {
+        msgpack_write(output, 0xcd, u, 2);
+      }
+      else if (u <= 0xffffffff)
+      {
+        msgpack_write(output, 0xce, u, 4);
+      } else {
+        msgpack_write(output, 0xcf, u, 8);
+      }
+    }
+
+    inline void
+    msgpack_write_signed(std::vector<std::uint8_t>& output, std::int64_t i)
+    {
+      const auto bits = static_cast<std::uint64_t>(i);
+
+      if (i >= 0)
+      {
+        msgpack_write_unsigned(output, bits);
+      }
+      else if (i >= -32)
+      {
+        output.push_back(static_cast<std::uint8_t>(bits));
+      }
+      else if (i >= std::numeric_limits<std::int8_t>::min())
+      {
+        msgpack_write(output, 0xd0, bits, 1);
+      }
+      else if (i >= std::numeric_limits<std::int16_t>::min())
+      {
+        msgpack_write(output, 0xd1, bits, 2);
+      }
+      else if (i >= std::numeric_limits<std::int32_t>::min())
+      {
+        msgpack_write(output, 0xd2, bits, 4);
+      } else {
+        msgpack_write(output, 0xd3, bits, 8);
+      }
+    }
+
+    inline void
+    msgpack_encode(std::vector<std::uint8_t>& output, const value& v)
+    {
+      switch (type_of(v))
+      {
+        case type::array:
+          {
+            const auto& elements = as_ref<array>(v).elements();
+
+            msgpack_write_length(
+              output,
+              elements.size(),
+              0x90,
+              16,
+              0,
+              0xdc,
+              0xdd
+            );
+            for (const auto& element : elements)
+            {
+              msgpack_encode(output, element);
+            }
+          }
+          break;
+
+        case type::boolean:
+          output.push_back(as_ref<boolean>(v).value() ? 0xc3 : 0xc2);
+          break;
+
+        case type::null:
+          output.push_back(0xc0);
+          break;
+
+        case type::number:
+          {
+            const auto& n = as_ref<number>(v);
+
+            if (n.kind() == number::kind::uint64)
+            {
+              msgpack_write_unsigned(output, *n.as_uint64());
+            }
+            else if (const auto i = binary_int64(n))
+            {
+              msgpack_write_signed(output, *i);
+            } else {
+              output.push_back(0xcb);
+              write_double(output, n.value());
+            }
+          }
+          break;
+
+        case type::object:
+          {
+            const auto& properties = as_ref<object>(v).properties();
+
+            msgpack_write_length(
+              output,
+              properties.size(),
+              0x80,
+              16,
+              0,
+              0xde,
+              0xdf
+            );
+            for (const auto& property : properties)
+            {
+              msgpack_write_string(output, property.first);
+              msgpack_encode(output, property.second);
+            }
+          }
+          break;
+
+        case type::string:
+          msgpack_write_string(output, as_ref<string>(v).value());
+          break;
+      }
+    }
+
+    /**
+     * Converts unsigned integer of given number of bytes into signed one.
+     */
+    inline std::int64_t
+    msgpack_signed(std::uint64_t value, std::size_t bytes)
+    {
+      const auto shift = 64 - bytes * 8;
+
+      return static_cast<std::int64_t>(value << shift) >> shift;
+    }
+
+    /**
+     * Reads length of a string, array or map from given head, or from the
+     * bytes following it. Returns false if the head is not of given kind.
+     */
+    inline bool
+    msgpack_read_length(
+      byte_reader& reader,
+      std::uint8_t head,
+      std::uint8_t fix_prefix,
+      std::uint8_t fix_mask,
+      std::uint8_t prefix8,
+      std::uint8_t prefix16,
+      std::uint8_t prefix32,
+      std::uint64_t& result
+    )
+    {
+      if ((head & ~fix_mask) == fix_prefix)
+      {
+        result = head & fix_mask;
+
+        return true;
+      }
+      else if (prefix8 && head == prefix8)
+      {
+        return reader.read(1, result);
+      }
+      else if (head == prefix16)
+      {
+        return reader.read(2, result);
+      }
+      else if (head == prefix32)
+      {
+        return reader.read(4, result);
+      }
+
+      return false;
+    }
+
+    inline bool
+    msgpack_read_string(
+      byte_reader& reader,
+      std::uint8_t head,
+      string::value_type& result
+    )
+    {
+      std::uint64_t length;
+
+      return msgpack_read_length(
+        reader,
+        head,
+        0xa0,
+        0x1f,
+        0xd9,
+        0xda,
+        0xdb,
+        length
+      ) && reader.read_utf8(length, result);
+    }
+
+    inline decode_result
+    msgpack_decode(
+      byte_reader& reader,
+      std::pmr::memory_resource* resource,
+      std::size_t depth = 0
+    )
+    {
+      std::uint64_t head;
+      std::uint64_t argument;
+
+      if (depth > max_decode_depth)
+      {
+        return reader.error("Maximum nesting depth exceeded.");
+      }
+      else if (!reader.read(1, head))
+      {
+        return reader.error("Unexpected end of input; Missing value.");
+      }
+
+      const auto byte = static_cast<std::uint8_t>(head);
+
+      if (byte < 0x80)
+      {
+        return decode_result::ok(number::make(byte, resource));
+      }
+      else if (byte >= 0xe0)
+      {
+        return decode_result::ok(number::make(
+          static_cast<std::int8_t>(byte),
+          resource
+        ));
+      }
+      else if ((byte & 0xe0) == 0xa0 || (byte >= 0xd9 && byte <= 0xdb))
+      {
+        string::value_type result(resource);
+
+        if (!msgpack_read_string(reader, byte, result))
+        {
+          return reader.error("Malformed string.");
+        }
+
+        return decode_result::ok(
+          make_node<string>(resource, std::move(result))
+        );
+      }
+      else if (
+        msgpack_read_length(reader, byte, 0x90, 0x0f, 0, 0xdc, 0xdd, argument)
+      )
+      {
+        array::container_type elements(resource);
+
+        // Every element takes at least one byte, which limits how much
+        // memory can be reserved up front.
+        elements.reserve(std::min<std::uint64_t>(
+          argument,
+          reader.remaining()
+        ));
+        for (std::uint64_t i = 0; i < argument; ++i)
+        {
+          const auto element = msgpack_decode(reader, resource, depth + 1);
+
+          if (!element)
+          {
+            return element;
+          }
+          elements.push_back(*element);
+        }
+
+        return decode_result::ok(
+          make_node<array>(resource, std::move(elements))
+        );
+      }
+      else if (
+        msgpack_read_length(reader, byte, 0x80, 0x0f, 0, 0xde, 0xdf, argument)
+      )
+      {
+        object::container_type properties(resource);
+
+        for (std::uint64_t i = 0; i < argument; ++i)
+        {
+          std::uint64_t key_head;
+          object::key_type key(resource);
+
+          if (
+            !reader.read(1, key_head) ||
+            !msgpack_read_string(
+              reader,
+              static_cast<std::uint8_t>(key_head),
+              key
+            )
+          )
+          {
+            return reader.error("Map keys must be strings.");
+          }
+
+          const auto property = msgpack_decode(
+            reader,
+            resource,
+            depth + 1
+          );
+
+          if (!property)
+          {
+            return property;
+          }
+          properties.insert_or_assign(std::move(key), *property);
+        }
+
+        return decode_result::ok(
+          make_node<object>(resource, std::move(properties))
+        );
+      }
+
+      switch (byte)
+      {
+        case 0xc0:
+          return decode_result::ok(nullptr);
+
+        case 0xc2:
+          return decode_result::ok(boolean::make(false, resource));
+
+        case 0xc3:
+          return decode_result::ok(boolean::make(true, resource));
+
+        case 0xca:
+          {
+            double result;
+
+            if (reader.read_float(result))
+            {
+              return decode_result::ok(number::make(result, resource));
+            }
+          }
+          break;
+
+        case 0xcb:
+          {
+            double result;
+
+            if (reader.read_double(result))
+            {
+              return decode_result::ok(number::make(result, resource));
+            }
+          }
+          break;
+
+        case 0xcc:
+        case 0xcd:
+        case 0xce:
+        case 0xcf:
+          if (reader.read(std::size_t(1) << (byte - 0xcc), argument))
+          {
+            return decode_result::ok(number::make(argument, resource));
+          }
+          break;
+
+        case 0xd0:
+        case 0xd1:
+        case 0xd2:
+        case 0xd3:
+          {
+            const auto bytes = std::size_t(1) << (byte - 0xd0);
+
+            if (reader.read(bytes, argument))
+            {
+              return decode_result::ok(number::make(
+                msgpack_signed(argument, bytes),
+                resource
+              ));
+            }
+          }
+          break;
+
+        default:
+          return reader.error("Unsupported type.");
+      }
+
+      return reader.error("Unexpected end of input; Missing number.");
+    }
+  }
+
+  /**
+   * Encodes given JSON value in MessagePack. Integers are encoded as
+   * integers and other numbers as double precision floating point values.
+   */
+  inline std::vector<std::uint8_t>
+  encode_msgpack(const value& v)
+  {
+    std::vector<std::uint8_t> result;
+
+    internal::msgpack_encode(result, v);
+
+    return result;
+  }
+
+  /**
+   * Decodes JSON value from MessagePack encoded data. Binary data,
+   * extension types and maps with other than string keys are not supported
+   * since they have no JSON representation. Arrays and maps can be nested
+   * at most 512 levels deep. Position of errors is given as byte offset.
+   */
+  inline decode_result
+  decode_msgpack(
+    const std::uint8_t* data,
+    std::size_t size,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+  )
+  {
+    internal::byte_reader reader(data, size);
+    const auto result = internal::msgpack_decode(reader, resource);
+
+    if (result && !reader.eof())
+    {
+      return reader.error("Unexpected input.");
+    }
+
+    return result;
+  }
+
+  inline decode_result
+  decode_msgpack(
+    const std::vector<std::uint8_t>& data,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+  )
+  {
+    return decode_msgpack(data.data(), data.size(), resource);
+  }
+}
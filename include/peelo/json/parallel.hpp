@@ -0,0 +1,438 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+# error "Intrusive reference counting does not support threads."
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include <peelo/json/formatter.hpp>
+#include <peelo/json/thread_pool.hpp>
+#include <peelo/json/visitor.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    /**
+     * Runs given callback against a formatter which appends into given
+     * string.
+     */
+    template<class Callback>
+    void
+    append_formatted(
+      std::string& result,
+      const format_options& options,
+      Callback callback
+    )
+    {
+      string_output output(result);
+      formatter<string_output> fmt(output, options);
+
+      callback(fmt);
+    }
+
+    void
+    parallel_format(
+      std::string&,
+      const value&,
+      thread_pool&,
+      const format_options&,
+      std::size_t
+    );
+
+    /**
+     * Splits elements of given container into slices of `grain_size`
+     * elements, formats each slice in the thread pool into it's own buffer
+     * and then joins the buffers in order.
+     */
+    template<class Container, class Callback>
+    void
+    parallel_format_container(
+      std::string& result,
+      const Container& container,
+      char open,
+      char close,
+      thread_pool& pool,
+      std::size_t grain_size,
+      Callback format_element
+    )
+    {
+      const auto size = container.size();
+      const auto slice_count = (size + grain_size - 1) / grain_size;
+      std::vector<std::string> slices(slice_count);
+      std::size_t length = 2 + slice_count - 1;
+      auto it = std::begin(container);
+
+      {
+        task_group group(pool);
+
+        for (std::size_t i = 0; i < slice_count; ++i)
+        {
+          const auto first = it;
+          const auto count = std::min(grain_size, size - i * grain_size);
+
+          std::advance(it, count);
+          group.run([&slices, &format_element, i, first, count]()
+          {
+            auto current = first;
+
+            for (std::size_t j = 0; j < count; ++j, ++current)
+            {
+              if (j > 0)
+              {
+                slices[i].append(1, ',');
+              }
+              format_element(slices[i], *current);
+            }
+          });
+        }
+        group.wait();
+      }
+
+      for (const auto& slice : slices)
+      {
+        length += slice.length();
+      }
+      result.reserve(result.length() + length);
+      result.append(1, open);
+      for (std::size_t i = 0; i < slice_count; ++i)
+      {
+        if (i > 0)
+        {
+          result.append(1, ',');
+        }
+        result.append(slices[i]);
+      }
+      result.append(1, close);
+    }
+
+    inline void
+    parallel_format(
+      std::string& result,
+      const value& v,
+      thread_pool& pool,
+      const format_options& options,
+      std::size_t grain_size
+    )
+    {
+      const auto t = type_of(v);
+
+      // Unmodified values are copied from the source code as they are, which
+      // is faster than splitting them up.
+      if (options.sources && !options.sort_keys && options.sources->find(v))
+      {
+        append_formatted(result, options, [&](auto& fmt)
+        {
+          fmt.output_value(v);
+        });
+      }
+      else if (
+        t == type::array &&
+        as_ref<array>(v).elements().size() > grain_size
+      )
+      {
+        parallel_format_container(
+          result,
+          as_ref<array>(v).elements(),
+          '[',
+          ']',
+          pool,
+          grain_size,
+          [&](std::string& slice, const array::value_type& element)
+          {
+            parallel_format(slice, element, pool, options, grain_size);
+          }
+        );
+      }
+      else if (
+        t == type::object &&
+        as_ref<object>(v).properties().size() > grain_size
+      )
+      {
+        const auto& properties = as_ref<object>(v).properties();
+        const auto format_property = [&](
+          std::string& slice,
+          const object::value_type& property
+        )
+        {
+          append_formatted(slice, options, [&](auto& fmt)
+          {
+            fmt.visit_string(property.first);
+          });
+          slice.append(1, ':');
+          parallel_format(slice, property.second, pool, options, grain_size);
+        };
+
+        if (options.sort_keys)
+        {
+          parallel_format_container(
+            result,
+            sorted_properties(properties),
+            '{',
+            '}',
+            pool,
+            grain_size,
+            [&](std::string& slice, const object::value_type* property)
+            {
+              format_property(slice, *property);
+            }
+          );
+        } else {
+          parallel_format_container(
+            result,
+            properties,
+            '{',
+            '}',
+            pool,
+            grain_size,
+            format_property
+          );
+        }
+      } else {
+        append_formatted(result, options, [&](auto& fmt)
+        {
+          fmt.output_value(v);
+        });
+      }
+    }
+  }
+
+  namespace internal
+  {
+    template<class Visitor, class Reduce>
+    void
+    parallel_accept(
+      thread_pool&,
+      const value&,
+      Visitor&,
+      const Visitor&,
+      Reduce&,
+      std::size_t
+    );
+
+    /**
+     * Splits elements of given container into slices of `grain_size`
+     * elements and traverses each slice in the thread pool with it's own
+     * copy of the prototype visitor. The slice visitors are then reduced
+     * into given visitor in order.
+     */
+    template<class Container, class Visitor, class Reduce, class Element>
+    void
+    parallel_accept_container(
+      thread_pool& pool,
+      const Container& container,
+      Visitor& visitor,
+      const Visitor& prototype,
+      Reduce& reduce,
+      std::size_t grain_size,
+      Element element_value
+    )
+    {
+      const auto size = container.size();
+      const auto slice_count = (size + grain_size - 1) / grain_size;
+      std::vector<Visitor> slices(slice_count, prototype);
+      auto it = std::begin(container);
+
+      {
+        task_group group(pool);
+
+        for (std::size_t i = 0; i < slice_count; ++i)
+        {
+          const auto first = it;
+          const auto count = std::min(grain_size, size - i * grain_size);
+
+          std::advance(it, count);
+          group.run([&, i, first, count]()
+          {
+            auto current = first;
+
+            for (std::size_t j = 0; j < count; ++j, ++current)
+            {
+              parallel_accept(
+                pool,
+                element_value(*current),
+                slices[i],
+                prototype,
+                reduce,
+                grain_size
+              );
+            }
+          });
+        }
+        group.wait();
+      }
+
+      for (auto& slice : slices)
+      {
+        reduce(visitor, std::move(slice));
+      }
+    }
+
+    /**
+     * Visits given value and all of it's descendants in pre-order. Small
+     * containers are traversed in the calling thread with an explicit stack,
+     * while large ones are split across the thread pool.
+     */
+    template<class Visitor, class Reduce>
+    void
+    parallel_accept(
+      thread_pool& pool,
+      const value& root,
+      Visitor& visitor,
+      const Visitor& prototype,
+      Reduce& reduce,
+      std::size_t grain_size
+    )
+    {
+      std::vector<const value*> stack = { &root };
+
+      while (!stack.empty())
+      {
+        const auto& v = *stack.back();
+
+        stack.pop_back();
+        accept(visitor, v);
+        if (type_of(v) == type::array)
+        {
+          const auto& elements = as_ref<array>(v).elements();
+
+          if (elements.size() > grain_size)
+          {
+            parallel_accept_container(
+              pool,
+              elements,
+              visitor,
+              prototype,
+              reduce,
+              grain_size,
+              [](const value& element) -> const value& { return element; }
+            );
+          } else {
+            for (auto i = elements.size(); i > 0; --i)
+            {
+              stack.push_back(&elements[i - 1]);
+            }
+          }
+        }
+        else if (type_of(v) == type::object)
+        {
+          const auto& properties = as_ref<object>(v).properties();
+
+          if (properties.size() > grain_size)
+          {
+            parallel_accept_container(
+              pool,
+              properties,
+              visitor,
+              prototype,
+              reduce,
+              grain_size,
+              [](const object::value_type& property) -> const value&
+              {
+                return property.second;
+              }
+            );
+          } else {
+            for (const auto& property : properties)
+            {
+              stack.push_back(&property.second);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  /**
+   * Visits given JSON value and all of it's descendants with a visitor,
+   * splitting arrays and objects with more than `grain_size` children into
+   * slices which are traversed in parallel in given thread pool.
+   *
+   * Unlike with `accept()`, the traversal itself descends into arrays and
+   * objects, so `visit_array()` and `visit_object()` must not visit the
+   * children themselves. Each slice is traversed with it's own copy of
+   * given visitor, and once the slices of a container have been traversed,
+   * they are merged into the visitor of the container with
+   * `reduce(Visitor& into, Visitor&& from)`, in the order of the slices.
+   * Returns the visitor which has visited the root value, after all slices
+   * have been merged into it.
+   */
+  template<class Visitor, class Reduce>
+  inline Visitor
+  parallel_accept(
+    thread_pool& pool,
+    const value& v,
+    const Visitor& prototype,
+    Reduce reduce,
+    std::size_t grain_size = 1024
+  )
+  {
+    Visitor result(prototype);
+
+    internal::parallel_accept(
+      pool,
+      v,
+      result,
+      prototype,
+      reduce,
+      grain_size > 0 ? grain_size : 1
+    );
+
+    return result;
+  }
+
+  /**
+   * Converts given JSON value into string like `format()` does, but arrays
+   * and objects with more than `grain_size` elements are split into slices
+   * which are formatted in parallel in given thread pool. The output is
+   * identical to the one produced by `format()`.
+   */
+  inline std::string
+  parallel_format(
+    thread_pool& pool,
+    const value& v,
+    const format_options& options = format_options(),
+    std::size_t grain_size = 1024
+  )
+  {
+    std::string result;
+
+    internal::parallel_format(
+      result,
+      v,
+      pool,
+      options,
+      grain_size > 0 ? grain_size : 1
+    );
+
+    return result;
+  }
+}
@@ -25,11 +25,31 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
 #include <cmath>
 #include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <istream>
+#include <iterator>
+#include <optional>
 #include <string>
+#include <system_error>
+
+#if defined(_WIN32)
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
 
 #include <peelo/json/exception.hpp>
+#include <peelo/json/source_map.hpp>
+#include <peelo/json/statistics.hpp>
+#include <peelo/json/utf8.hpp>
 #include <peelo/json/value.hpp>
 #include <peelo/result.hpp>
 
@@ -38,14 +58,486 @@ namespace peelo::json
   using parse_result = result<value, parse_error>;
   using parse_object_result = result<object::ptr, parse_error>;
 
+  /**
+   * Options which can be given to the parser.
+   */
+  struct parse_options
+  {
+    /**
+     * Observer that receives statistics of each parse. Statistics are only
+     * collected when the library is compiled with
+     * `PEELO_JSON_ENABLE_STATISTICS` defined, otherwise the observer is never
+     * called.
+     */
+    parse_observer* observer = nullptr;
+
+    /**
+     * Memory resource from which all of the parsed values, including their
+     * containers and strings, are allocated. The resource must outlive the
+     * parsed values.
+     */
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource();
+
+    /**
+     * Optional map into which the range of source code each array, number,
+     * object and string was parsed from is recorded. This allows the
+     * formatter to output values which have not been modified exactly as
+     * they were in the source code.
+     */
+    source_map* sources = nullptr;
+  };
+
+  /**
+   * Abstract source of UTF-8 encoded JSON. The parser reads it's input from
+   * an input in chunks into a fixed size buffer, so the whole input never
+   * needs to be held in memory at once.
+   */
+  class input
+  {
+  public:
+    /**
+     * Reads at most `size` bytes into given buffer. Returns the number of
+     * bytes read, or zero when the end of input has been reached or reading
+     * has failed.
+     */
+    virtual std::size_t
+    read(char* data, std::size_t size) = 0;
+
+    /**
+     * Returns true if reading from the input has failed.
+     */
+    virtual bool
+    failed() const = 0;
+  };
+
+  /**
+   * Input that reads from an input stream.
+   */
+  class istream_input final : public input
+  {
+  public:
+    explicit istream_input(std::istream& stream)
+      : m_stream(stream) {}
+
+    std::size_t read(char* data, std::size_t size)
+    {
+      m_stream.read(data, static_cast<std::streamsize>(size));
+
+      return static_cast<std::size_t>(m_stream.gcount());
+    }
+
+    bool failed() const
+    {
+      return m_stream.bad();
+    }
+
+  private:
+    std::istream& m_stream;
+  };
+
+  /**
+   * Input that reads from a C standard library file handle.
+   */
+  class file_input final : public input
+  {
+  public:
+    explicit file_input(std::FILE* file)
+      : m_file(file) {}
+
+    std::size_t read(char* data, std::size_t size)
+    {
+      return std::fread(data, 1, size, m_file);
+    }
+
+    bool failed() const
+    {
+      return std::ferror(m_file) != 0;
+    }
+
+  private:
+    std::FILE* m_file;
+  };
+
+  /**
+   * Input that reads from a raw file descriptor, such as a pipe or a
+   * socket.
+   */
+  class fd_input final : public input
+  {
+  public:
+    explicit fd_input(int fd)
+      : m_fd(fd)
+      , m_failed(false) {}
+
+    std::size_t read(char* data, std::size_t size)
+    {
+      while (!m_failed)
+      {
+#if defined(_WIN32)
+        const auto result = ::_read(
+          m_fd,
+          data,
+          static_cast<unsigned int>(size)
+        );
+#else
+        const auto result = ::read(m_fd, data, size);
+#endif
+
+        if (result >= 0)
+        {
+          return static_cast<std::size_t>(result);
+        }
+        else if (errno != EINTR)
+        {
+          m_failed = true;
+        }
+      }
+
+      return 0;
+    }
+
+    bool failed() const
+    {
+      return m_failed;
+    }
+
+  private:
+    int m_fd;
+    bool m_failed;
+  };
+
+  namespace internal
+  {
+    /**
+     * Reads UTF-8 encoded input through a fixed size buffer and decodes it
+     * one code point at a time. Reading stops at the first invalid UTF-8
+     * sequence, which is then reported by `invalid()`.
+     */
+    class input_reader
+    {
+    public:
+      static constexpr std::size_t buffer_size = 4096;
+
+      explicit input_reader(class input& input)
+        : m_input(input)
+        , m_position(0)
+        , m_size(0)
+        , m_current(0)
+        , m_eof(false)
+        , m_exhausted(false)
+        , m_invalid(false)
+      {
+        next();
+        // Skip byte order mark.
+        if (!m_eof && m_current == 0xfeff)
+        {
+          next();
+        }
+      }
+
+      input_reader(const input_reader&) = delete;
+      input_reader(input_reader&&) = delete;
+      void operator=(const input_reader&) = delete;
+      void operator=(input_reader&&) = delete;
+
+      inline char32_t current() const
+      {
+        return m_current;
+      }
+
+      inline bool eof() const
+      {
+        return m_eof;
+      }
+
+      inline bool invalid() const
+      {
+        return m_invalid;
+      }
+
+      void next()
+      {
+        while (!m_eof)
+        {
+          const auto available = m_size - m_position;
+          std::size_t length;
+
+          if (available > 0 && (length = decode_utf8(
+            m_buffer + m_position,
+            available,
+            m_current
+          )))
+          {
+            m_position += length;
+            break;
+          }
+          else if (m_exhausted || available >= 4)
+          {
+            m_eof = true;
+            m_invalid = available > 0;
+          } else {
+            fill();
+          }
+        }
+      }
+
+    private:
+      /**
+       * Moves the remaining bytes of an incomplete code point to the
+       * beginning of the buffer and fills rest of the buffer from the input.
+       */
+      void fill()
+      {
+        std::memmove(m_buffer, m_buffer + m_position, m_size - m_position);
+        m_size -= m_position;
+        m_position = 0;
+
+        const auto read = m_input.read(
+          reinterpret_cast<char*>(m_buffer + m_size),
+          buffer_size - m_size
+        );
+
+        if (!read)
+        {
+          m_exhausted = true;
+        }
+        m_size += read;
+      }
+
+      class input& m_input;
+      unsigned char m_buffer[buffer_size];
+      std::size_t m_position;
+      std::size_t m_size;
+      char32_t m_current;
+      bool m_eof;
+      bool m_exhausted;
+      bool m_invalid;
+    };
+
+    /**
+     * Single pass iterator over code points decoded by an input reader.
+     * Default constructed iterator marks the end of input.
+     */
+    class input_iterator
+    {
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type = char32_t;
+      using difference_type = std::ptrdiff_t;
+      using pointer = const char32_t*;
+      using reference = char32_t;
+
+      /**
+       * Holds the code point which was current before post-increment.
+       */
+      struct proxy
+      {
+        char32_t c;
+
+        inline char32_t operator*() const
+        {
+          return c;
+        }
+      };
+
+      explicit input_iterator(input_reader* reader = nullptr)
+        : m_reader(reader) {}
+
+      inline char32_t operator*() const
+      {
+        return m_reader->current();
+      }
+
+      inline input_iterator& operator++()
+      {
+        m_reader->next();
+
+        return *this;
+      }
+
+      inline proxy operator++(int)
+      {
+        const proxy result = { m_reader->current() };
+
+        m_reader->next();
+
+        return result;
+      }
+
+      inline bool operator==(const input_iterator& that) const
+      {
+        return at_end() == that.at_end();
+      }
+
+      inline bool operator!=(const input_iterator& that) const
+      {
+        return at_end() != that.at_end();
+      }
+
+    private:
+      inline bool at_end() const
+      {
+        return !m_reader || m_reader->eof();
+      }
+
+      input_reader* m_reader;
+    };
+  }
+
   namespace internal
   {
+    /**
+     * State shared by all parsing routines during a single parse.
+     */
+    struct parse_context
+    {
+      explicit parse_context(const parse_options& options)
+        : resource(options.resource)
+        , sources(options.sources) {}
+
+      std::pmr::memory_resource* resource;
+      source_map* sources;
+      /**
+       * Offset of the last token which the parser accepts even though it's
+       * not valid JSON, such as number with a leading plus sign or leading
+       * zeros, `\'` escape sequence, unescaped control character in string
+       * or whitespace other than the four allowed by JSON. Source code
+       * containing such tokens is not recorded into the source map, so it's
+       * never copied into output as it is.
+       */
+      std::optional<std::size_t> lenient;
+#if defined(PEELO_JSON_ENABLE_STATISTICS)
+      parse_statistics statistics;
+      std::size_t depth = 0;
+#endif
+    };
+
+    /**
+     * Measures time spent in a parsing routine and keeps track of nesting
+     * depth of arrays and objects. Does nothing unless statistics are enabled.
+     */
+    class routine_scope
+    {
+    public:
+#if defined(PEELO_JSON_ENABLE_STATISTICS)
+      explicit routine_scope(parse_context& context, parse_routine routine)
+        : m_context(context)
+        , m_routine(routine)
+        , m_start(std::chrono::steady_clock::now())
+      {
+        if (is_container() && ++m_context.depth > max_depth())
+        {
+          max_depth() = m_context.depth;
+        }
+      }
+
+      ~routine_scope()
+      {
+        const auto index = static_cast<std::size_t>(m_routine);
+
+        if (is_container())
+        {
+          --m_context.depth;
+        }
+        m_context.statistics.routine_times[index] +=
+          std::chrono::steady_clock::now() - m_start;
+      }
+#else
+      explicit routine_scope(parse_context&, parse_routine) {}
+#endif
+
+      routine_scope(const routine_scope&) = delete;
+      routine_scope(routine_scope&&) = delete;
+      void operator=(const routine_scope&) = delete;
+      void operator=(routine_scope&&) = delete;
+
+#if defined(PEELO_JSON_ENABLE_STATISTICS)
+    private:
+      inline bool is_container() const
+      {
+        return m_routine == parse_routine::array
+          || m_routine == parse_routine::object;
+      }
+
+      inline std::size_t& max_depth()
+      {
+        return m_context.statistics.max_depth;
+      }
+
+    private:
+      parse_context& m_context;
+      const parse_routine m_routine;
+      const std::chrono::steady_clock::time_point m_start;
+#endif
+    };
+
+#if defined(PEELO_JSON_ENABLE_STATISTICS)
+    inline void
+    count_node(parse_context& context, enum type type)
+    {
+      ++context.statistics.node_counts[static_cast<std::size_t>(type)];
+      if (type != type::null)
+      {
+        ++context.statistics.node_allocations;
+      }
+    }
+
+    inline void
+    count_string(parse_context& context, std::size_t length)
+    {
+      context.statistics.string_bytes += length * sizeof(char32_t);
+    }
+
+    inline void
+    notify_observer(const parse_context& context, const parse_options& options)
+    {
+      if (options.observer)
+      {
+        options.observer->on_parse(context.statistics);
+      }
+    }
+#else
+    inline void
+    count_node(parse_context&, enum type) {}
+
+    inline void
+    count_string(parse_context&, std::size_t) {}
+
+    inline void
+    notify_observer(const parse_context&, const parse_options&) {}
+#endif
+
+    /**
+     * Records the range of source code given value was parsed from, if
+     * source map is being used.
+     */
+    inline parse_result
+    record_source(
+      parse_context& context,
+      parse_result result,
+      std::size_t offset,
+      const struct position& position
+    )
+    {
+      if (
+        context.sources &&
+        result &&
+        !(context.lenient && *context.lenient >= offset)
+      )
+      {
+        context.sources->insert(*result, offset, position.offset - offset);
+      }
+
+      return result;
+    }
+
     template<class Iterator>
     parse_result
     parse_value(
       Iterator&,
       const Iterator&,
-      position&
+      position&,
+      parse_context&
     );
 
     template<class Iterator>
@@ -55,7 +547,7 @@ namespace peelo::json
       const Iterator& end
     )
     {
-      return current >= end;
+      return current == end;
     }
 
     template<class Iterator>
@@ -67,6 +559,7 @@ namespace peelo::json
     {
       const auto c = *current++;
 
+      ++position.offset;
       if (c == '\n')
       {
         ++position.line;
@@ -125,15 +618,22 @@ namespace peelo::json
     eat_whitespace(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
       while (!eof(current, end))
       {
-        if (!std::isspace(*current))
+        const auto c = *current;
+
+        if (!std::isspace(c))
         {
           return true;
         }
+        else if (c != U' ' && c != U'\t' && c != U'\n' && c != U'\r')
+        {
+          context.lenient = position.offset;
+        }
         advance(current, position);
       }
 
@@ -167,11 +667,14 @@ namespace peelo::json
     parse_false(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
+      const routine_scope scope(context, parse_routine::boolean);
+
       if (
-        !eat_whitespace(current, end, position) ||
+        !eat_whitespace(current, end, position, context) ||
         !peek_advance(current, end, position, 'f') ||
         !peek_advance(current, end, position, 'a') ||
         !peek_advance(current, end, position, 'l') ||
@@ -185,7 +688,9 @@ namespace peelo::json
         });
       }
 
-      return parse_result::ok(std::make_shared<boolean>(false));
+      count_node(context, type::boolean);
+
+      return parse_result::ok(boolean::make(false, context.resource));
     }
 
     template<class Iterator>
@@ -193,11 +698,14 @@ namespace peelo::json
     parse_true(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
+      const routine_scope scope(context, parse_routine::boolean);
+
       if (
-        !eat_whitespace(current, end, position) ||
+        !eat_whitespace(current, end, position, context) ||
         !peek_advance(current, end, position, 't') ||
         !peek_advance(current, end, position, 'r') ||
         !peek_advance(current, end, position, 'u') ||
@@ -210,7 +718,9 @@ namespace peelo::json
         });
       }
 
-      return parse_result::ok(std::make_shared<boolean>(true));
+      count_node(context, type::boolean);
+
+      return parse_result::ok(boolean::make(true, context.resource));
     }
 
     template<class Iterator>
@@ -218,11 +728,14 @@ namespace peelo::json
     parse_null(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
+      const routine_scope scope(context, parse_routine::null);
+
       if (
-        !eat_whitespace(current, end, position) ||
+        !eat_whitespace(current, end, position, context) ||
         !peek_advance(current, end, position, 'n') ||
         !peek_advance(current, end, position, 'u') ||
         !peek_advance(current, end, position, 'l') ||
@@ -235,6 +748,8 @@ namespace peelo::json
         });
       }
 
+      count_node(context, type::null);
+
       return parse_result::ok(nullptr);
     }
 
@@ -252,14 +767,63 @@ namespace peelo::json
 
     using parse_escape_sequence_result = peelo::result<char32_t, parse_error>;
 
+    /**
+     * Parses the four hexadecimal digits of an Unicode escape sequence.
+     */
     template<class Iterator>
     parse_escape_sequence_result
-    parse_escape_sequence(
+    parse_hex_escape(
       Iterator& current,
       const Iterator& end,
       struct position& position
     )
     {
+      char32_t result = 0;
+
+      for (int i = 0; i < 4; ++i)
+      {
+        if (eof(current, end))
+        {
+          return parse_escape_sequence_result::error({
+            position,
+            "Unterminated escape sequence."
+          });
+        }
+        else if (!std::isxdigit(*current))
+        {
+          return parse_escape_sequence_result::error({
+            position,
+            "Illegal Unicode hex escape sequence."
+          });
+        }
+
+        if (*current >= 'A' && *current <= 'F')
+        {
+          result = result * 16 + (*current - 'A' + 10);
+        }
+        else if (*current >= 'a' && *current <= 'f')
+        {
+          result = result * 16 + (*current - 'a' + 10);
+        } else {
+          result = result * 16 + (*current - '0');
+        }
+
+        advance(current, position);
+      }
+
+      return parse_escape_sequence_result::ok(result);
+    }
+
+    template<class Iterator>
+    parse_escape_sequence_result
+    parse_escape_sequence(
+      Iterator& current,
+      const Iterator& end,
+      struct position& position,
+      parse_context& context
+    )
+    {
+      const routine_scope scope(context, parse_routine::escape_sequence);
       char32_t result;
 
       if (eof(current, end))
@@ -286,7 +850,7 @@ namespace peelo::json
         });
       }
 
-      switch (advance(current, position))
+      switch (result = advance(current, position))
       {
         case 'b':
           result = 010;
@@ -308,44 +872,55 @@ namespace peelo::json
           result = 015;
           break;
 
-        case '"':
         case '\'':
+          context.lenient = position.offset;
+          break;
+
+        case '"':
         case '\\':
         case '/':
-          result = *(current - 1);
           break;
 
         case 'u':
-          result = 0;
-          for (int i = 0; i < 4; ++i)
           {
-            if (current >= end)
+            const auto high = parse_hex_escape(current, end, position);
+
+            if (!high)
             {
-              return parse_escape_sequence_result::error({
-                position,
-                "Unterminated escape sequence."
-              });
+              return high;
             }
-            else if (!std::isxdigit(*current))
+            result = *high;
+          }
+
+          // Code points outside of the Basic Multilingual Plane are escaped
+          // as surrogate pairs.
+          if (result >= 0xd800 && result <= 0xdbff)
+          {
+            if (
+              !peek_advance(current, end, position, U'\\') ||
+              !peek_advance(current, end, position, U'u')
+            )
             {
               return parse_escape_sequence_result::error({
                 position,
-                "Illegal Unicode hex escape sequence."
+                "Unpaired surrogate in Unicode hex escape sequence."
               });
             }
 
-            if (*current >= 'A' && *current <= 'F')
+            const auto low = parse_hex_escape(current, end, position);
+
+            if (!low)
             {
-              result = result * 16 + (*current - 'A' + 10);
+              return low;
             }
-            else if (*current >= 'a' && *current <= 'f')
+            else if (*low < 0xdc00 || *low > 0xdfff)
             {
-              result = result * 16 + (*current - 'a' + 10);
-            } else {
-              result = result * 16 + (*current - '0');
+              return parse_escape_sequence_result::error({
+                position,
+                "Unpaired surrogate in Unicode hex escape sequence."
+              });
             }
-
-            advance(current, position);
+            result = 0x10000 + ((result - 0xd800) << 10) + (*low - 0xdc00);
           }
 
           if (!is_valid_unicode_codepoint(result))
@@ -367,20 +942,25 @@ namespace peelo::json
       return parse_escape_sequence_result::ok(result);
     }
 
-    using parse_string_result = peelo::result<std::u32string, parse_error>;
+    using parse_string_result = peelo::result<
+      string::value_type,
+      parse_error
+    >;
 
     template<class Iterator>
     parse_string_result
     parse_string(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
+      const routine_scope scope(context, parse_routine::string);
       struct position start_position;
-      std::u32string result;
+      string::value_type result(context.resource);
 
-      if (!eat_whitespace(current, end, position))
+      if (!eat_whitespace(current, end, position, context))
       {
         return parse_string_result::error({
           position,
@@ -416,7 +996,8 @@ namespace peelo::json
           const auto escape_sequence = parse_escape_sequence(
             current,
             end,
-            position
+            position,
+            context
           );
 
           if (!escape_sequence)
@@ -425,11 +1006,17 @@ namespace peelo::json
           }
           result.append(1, *escape_sequence);
         } else {
+          if (*current < 0x20)
+          {
+            context.lenient = position.offset;
+          }
           result.append(1, advance(current, position));
         }
       }
 
-      return parse_string_result::ok(result);
+      count_string(context, result.length());
+
+      return parse_string_result::ok(std::move(result));
     }
 
     template<class Iterator>
@@ -437,13 +1024,15 @@ namespace peelo::json
     parse_object(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
+      const routine_scope scope(context, parse_routine::object);
       struct position start_position;
-      object::container_type properties;
+      object::container_type properties(context.resource);
 
-      if (!eat_whitespace(current, end, position))
+      if (!eat_whitespace(current, end, position, context))
       {
         return parse_result::error({
           position,
@@ -462,22 +1051,32 @@ namespace peelo::json
       }
 
       // Look for an empty object.
-      eat_whitespace(current, end, position);
+      eat_whitespace(current, end, position, context);
       if (peek_advance(current, end, position, U'}'))
       {
-        return parse_result::ok(std::make_shared<object>());
+        count_node(context, type::object);
+
+        return parse_result::ok(make_node<object>(
+          context.resource,
+          std::move(properties)
+        ));
       }
 
       for (;;)
       {
-        const auto key_result = parse_string(current, end, position);
+        const auto key_result = parse_string(
+          current,
+          end,
+          position,
+          context
+        );
 
         if (!key_result)
         {
           return parse_result::error(key_result.error());
         }
 
-        eat_whitespace(current, end, position);
+        eat_whitespace(current, end, position, context);
         if (!peek_advance(current, end, position, U':'))
         {
           return parse_result::error({
@@ -486,16 +1085,16 @@ namespace peelo::json
           });
         }
 
-        const auto value_result = parse_value(current, end, position);
+        const auto value_result = parse_value(current, end, position, context);
 
         if (!value_result)
         {
           return parse_result::error(value_result.error());
         }
 
-        properties[*key_result] = *value_result;
+        properties.insert_or_assign(*key_result, *value_result);
 
-        eat_whitespace(current, end, position);
+        eat_whitespace(current, end, position, context);
 
         if (peek_advance(current, end, position, U','))
         {
@@ -512,7 +1111,12 @@ namespace peelo::json
         break;
       }
 
-      return parse_result::ok(std::make_shared<object>(properties));
+      count_node(context, type::object);
+
+      return parse_result::ok(make_node<object>(
+        context.resource,
+        std::move(properties)
+      ));
     }
 
     template<class Iterator>
@@ -520,13 +1124,15 @@ namespace peelo::json
     parse_array(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
+      const routine_scope scope(context, parse_routine::array);
       struct position start_position;
-      array::container_type elements;
+      array::container_type elements(context.resource);
 
-      if (!eat_whitespace(current, end, position))
+      if (!eat_whitespace(current, end, position, context))
       {
         return parse_result::error({
           position,
@@ -545,15 +1151,20 @@ namespace peelo::json
       }
 
       // Look for an empty array.
-      eat_whitespace(current, end, position);
+      eat_whitespace(current, end, position, context);
       if (peek_advance(current, end, position, U']'))
       {
-        return parse_result::ok(std::make_shared<array>());
+        count_node(context, type::array);
+
+        return parse_result::ok(make_node<array>(
+          context.resource,
+          std::move(elements)
+        ));
       }
 
       for (;;)
       {
-        const auto result = parse_value(current, end, position);
+        const auto result = parse_value(current, end, position, context);
 
         if (!result)
         {
@@ -562,7 +1173,7 @@ namespace peelo::json
 
         elements.push_back(*result);
 
-        eat_whitespace(current, end, position);
+        eat_whitespace(current, end, position, context);
 
         if (peek_advance(current, end, position, U','))
         {
@@ -579,7 +1190,12 @@ namespace peelo::json
         break;
       }
 
-      return parse_result::ok(std::make_shared<array>(elements));
+      count_node(context, type::array);
+
+      return parse_result::ok(make_node<array>(
+        context.resource,
+        std::move(elements)
+      ));
     }
 
     template<class Iterator>
@@ -587,14 +1203,19 @@ namespace peelo::json
     parse_number(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
+      const routine_scope scope(context, parse_routine::number);
       struct position start_position;
       std::string buffer;
-      double result;
+      std::size_t integer_digits;
+      std::size_t exponent = 0;
+      bool is_integer = true;
+      bool is_canonical = true;
 
-      if (!eat_whitespace(current, end, position))
+      if (!eat_whitespace(current, end, position, context))
       {
         return parse_result::error({
           position,
@@ -607,10 +1228,13 @@ namespace peelo::json
       if (peek_advance(current, end, position, U'-'))
       {
         buffer.append(1, '-');
-      } else {
-        peek_advance(current, end, position, U'+');
+      }
+      else if (peek_advance(current, end, position, U'+'))
+      {
+        is_canonical = false;
       }
 
+      integer_digits = buffer.length();
       if (!eat_digits(current, end, position, buffer))
       {
         return parse_result::error({
@@ -618,9 +1242,18 @@ namespace peelo::json
           "Unexpected input; Missing number."
         });
       }
+      if (
+        buffer.length() - integer_digits > 1 &&
+        buffer[integer_digits] == '0'
+      )
+      {
+        is_canonical = false;
+      }
+      integer_digits = buffer.length() - integer_digits;
 
       if (peek_advance(current, end, position, U'.'))
       {
+        is_integer = false;
         buffer.append(1, '.');
         if (!eat_digits(current, end, position, buffer))
         {
@@ -636,6 +1269,9 @@ namespace peelo::json
         peek_advance(current, end, position, U'E')
       )
       {
+        const auto exponent_start = buffer.length() + 1;
+
+        is_integer = false;
         buffer.append(1, 'e');
         if (!eat_digits(current, end, position, buffer))
         {
@@ -644,18 +1280,81 @@ namespace peelo::json
             "Unexpected input; Missing digits after exponent."
           });
         }
+        for (auto i = exponent_start; i < buffer.length(); ++i)
+        {
+          exponent = std::min<std::size_t>(
+            exponent * 10 + (buffer[i] - '0'),
+            100000
+          );
+        }
       }
 
-      result = std::strtod(buffer.c_str(), nullptr);
-      if (result == HUGE_VAL)
+      const auto first = buffer.data();
+      const auto last = first + buffer.length();
+
+      // Conversion into double is deferred until the value is needed, unless
+      // the number might be too large to be represented as double.
+      if (integer_digits + exponent > 308)
       {
-        return parse_result::error({
-          start_position,
-          "Number out of bounds."
-        });
+        double result;
+
+        if (!parse_double(first, last, result) || std::isinf(result))
+        {
+          return parse_result::error({
+            start_position,
+            "Number out of bounds."
+          });
+        }
+      }
+
+      if (!is_canonical)
+      {
+        context.lenient = start_position.offset;
+      }
+
+      count_node(context, type::number);
+
+      if (is_integer)
+      {
+        std::int64_t signed_result;
+        std::uint64_t unsigned_result;
+
+        if (std::from_chars(first, last, signed_result).ec == std::errc())
+        {
+          // Negative zero cannot be represented as an integer.
+          if (signed_result == 0 && buffer[0] == '-')
+          {
+            return parse_result::ok(number::make(-0.0, context.resource));
+          }
+
+          return parse_result::ok(number::make(
+            signed_result,
+            context.resource
+          ));
+        }
+        else if (
+          std::from_chars(first, last, unsigned_result).ec == std::errc()
+        )
+        {
+          return parse_result::ok(number::make(
+            unsigned_result,
+            context.resource
+          ));
+        }
       }
 
-      return parse_result::ok(std::make_shared<number>(result));
+      // Digits are output as they are, so they're only retained when they
+      // are valid JSON.
+      if (!is_canonical)
+      {
+        double result;
+
+        parse_double(first, last, result);
+
+        return parse_result::ok(number::make(result, context.resource));
+      }
+
+      return parse_result::ok(number::make_digits(buffer, context.resource));
     }
 
     template<class Iterator>
@@ -663,10 +1362,13 @@ namespace peelo::json
     parse_value(
       Iterator& current,
       const Iterator& end,
-      struct position& position
+      struct position& position,
+      parse_context& context
     )
     {
-      if (!eat_whitespace(current, end, position))
+      const routine_scope scope(context, parse_routine::value);
+
+      if (!eat_whitespace(current, end, position, context))
       {
         return parse_result::error({
           position,
@@ -674,34 +1376,53 @@ namespace peelo::json
         });
       }
 
+      const auto offset = position.offset;
+
       switch (*current)
       {
         case U'[':
-          return parse_array(current, end, position);
+          return record_source(
+            context,
+            parse_array(current, end, position, context),
+            offset,
+            position
+          );
 
         case U'{':
-          return parse_object(current, end, position);
+          return record_source(
+            context,
+            parse_object(current, end, position, context),
+            offset,
+            position
+          );
 
         case U'"':
           {
-            const auto result = parse_string(current, end, position);
+            const auto result = parse_string(current, end, position, context);
 
             if (result)
             {
-              return parse_result::ok(std::make_shared<string>(*result));
+              count_node(context, type::string);
+
+              return record_source(
+                context,
+                parse_result::ok(string::make(*result, context.resource)),
+                offset,
+                position
+              );
             }
 
             return parse_result::error(result.error());
           }
 
         case U't':
-          return parse_true(current, end, position);
+          return parse_true(current, end, position, context);
 
         case U'f':
-          return parse_false(current, end, position);
+          return parse_false(current, end, position, context);
 
         case U'n':
-          return parse_null(current, end, position);
+          return parse_null(current, end, position, context);
 
         case U'+':
         case U'-':
@@ -715,7 +1436,12 @@ namespace peelo::json
         case U'7':
         case U'8':
         case U'9':
-          return parse_number(current, end, position);
+          return record_source(
+            context,
+            parse_number(current, end, position, context),
+            offset,
+            position
+          );
       }
 
       return parse_result::error({
@@ -723,55 +1449,237 @@ namespace peelo::json
         "Unexpected input; Missing value."
       });
     }
+
+    template<class Iterator>
+    parse_result
+    parse_object_document(
+      Iterator& current,
+      const Iterator& end,
+      struct position& position,
+      parse_context& context
+    )
+    {
+      eat_whitespace(current, end, position, context);
+
+      const auto offset = position.offset;
+
+      return record_source(
+        context,
+        parse_object(current, end, position, context),
+        offset,
+        position
+      );
+    }
+
+    template<class Iterator>
+    parse_result
+    parse_document(
+      Iterator current,
+      const Iterator& end,
+      struct position& position,
+      const parse_options& options,
+      bool object_only
+    )
+    {
+      parse_context context(options);
+      const auto result = object_only
+        ? parse_object_document(current, end, position, context)
+        : parse_value(current, end, position, context);
+
+      notify_observer(context, options);
+      if (result)
+      {
+        eat_whitespace(current, end, position, context);
+        if (!eof(current, end))
+        {
+          if (options.sources)
+          {
+            options.sources->clear();
+          }
+
+          return parse_result::error({ position, "Unexpected input." });
+        }
+        if (options.sources)
+        {
+          options.sources->set_root(*result);
+        }
+      }
+      else if (options.sources)
+      {
+        options.sources->clear();
+      }
+
+      return result;
+    }
   }
 
   inline parse_result
   parse(
     const std::u32string& source,
+    const parse_options& options,
     int line = 1,
     int column = 1
   )
   {
-    auto it = std::begin(source);
-    const auto end = std::end(source);
-    struct position position{line, column};
-    const auto result = internal::parse_value(it, end, position);
+    struct position position = { line, column };
 
-    if (!result)
+    if (options.sources)
     {
-      return result;
+      options.sources->reset(source);
     }
-    internal::eat_whitespace(it, end, position);
-    if (!internal::eof(it, end))
+
+    return internal::parse_document(
+      std::begin(source),
+      std::end(source),
+      position,
+      options,
+      false
+    );
+  }
+
+  inline parse_result
+  parse(
+    const std::u32string& source,
+    int line = 1,
+    int column = 1
+  )
+  {
+    return parse(source, parse_options(), line, column);
+  }
+
+  namespace internal
+  {
+    inline parse_result
+    parse_input(
+      input& in,
+      const parse_options& options,
+      int line,
+      int column,
+      bool object_only
+    )
     {
-      return parse_result::error({ position, "Unexpected input." });
+      struct position position = { line, column };
+      parse_options input_options(options);
+      input_reader reader(in);
+
+      // Source code of stream input is not retained, so it cannot be
+      // recorded into a source map.
+      input_options.sources = nullptr;
+
+      const auto result = parse_document(
+        input_iterator(&reader),
+        input_iterator(),
+        position,
+        input_options,
+        object_only
+      );
+
+      if (reader.invalid())
+      {
+        return parse_result::error({ position, "Invalid UTF-8 input." });
+      }
+      else if (in.failed())
+      {
+        return parse_result::error({ position, "Unable to read input." });
+      }
+
+      return result;
     }
+  }
 
-    return result;
+  /**
+   * Parses UTF-8 encoded JSON read from given input, such as a stream, a
+   * pipe or a socket. The input is read through a fixed size buffer, so
+   * it's never held in memory as a whole. Source maps are not supported
+   * with inputs, and are ignored.
+   */
+  inline parse_result
+  parse(
+    input& in,
+    const parse_options& options,
+    int line = 1,
+    int column = 1
+  )
+  {
+    return internal::parse_input(in, options, line, column, false);
+  }
+
+  inline parse_result
+  parse(
+    input& in,
+    int line = 1,
+    int column = 1
+  )
+  {
+    return parse(in, parse_options(), line, column);
   }
 
   inline parse_object_result
   parse_object(
     const std::u32string& source,
+    const parse_options& options,
     int line = 1,
     int column = 1
   )
   {
-    auto it = std::begin(source);
-    const auto end = std::end(source);
-    struct position position{line, column};
-    const auto result = internal::parse_object(it, end, position);
+    struct position position = { line, column };
+
+    if (options.sources)
+    {
+      options.sources->reset(source);
+    }
+
+    const auto result = internal::parse_document(
+      std::begin(source),
+      std::end(source),
+      position,
+      options,
+      true
+    );
 
     if (!result)
     {
       return parse_object_result::error(result.error());
     }
-    internal::eat_whitespace(it, end, position);
-    if (!internal::eof(it, end))
+
+    return parse_object_result::ok(as<object>(result.value()));
+  }
+
+  inline parse_object_result
+  parse_object(
+    const std::u32string& source,
+    int line = 1,
+    int column = 1
+  )
+  {
+    return parse_object(source, parse_options(), line, column);
+  }
+
+  inline parse_object_result
+  parse_object(
+    input& in,
+    const parse_options& options,
+    int line = 1,
+    int column = 1
+  )
+  {
+    const auto result = internal::parse_input(in, options, line, column, true);
+
+    if (!result)
     {
-      return parse_object_result::error({ position, "Unexpected input." });
+      return parse_object_result::error(result.error());
     }
 
-    return parse_object_result::ok(std::static_pointer_cast<object>(result.value()));
+    return parse_object_result::ok(as<object>(result.value()));
+  }
+
+  inline parse_object_result
+  parse_object(
+    input& in,
+    int line = 1,
+    int column = 1
+  )
+  {
+    return parse_object(in, parse_options(), line, column);
   }
 }
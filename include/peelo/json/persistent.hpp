@@ -0,0 +1,874 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    /**
+     * Number of bits of index or hash consumed by each level of persistent
+     * containers, which gives every node 32 slots.
+     */
+    inline constexpr unsigned persistent_bits = 5;
+
+    inline constexpr std::size_t persistent_width =
+      std::size_t(1) << persistent_bits;
+
+    inline constexpr std::size_t persistent_mask = persistent_width - 1;
+
+    inline constexpr unsigned persistent_hash_bits =
+      std::numeric_limits<std::size_t>::digits;
+
+    /**
+     * Common base class for nodes of persistent containers. Nodes are never
+     * modified once they have been shared, so an update copies only the
+     * nodes on the path from the root to the updated slot.
+     */
+    struct persistent_node {};
+
+    using persistent_node_ptr = std::shared_ptr<const persistent_node>;
+
+    struct vector_branch final : public persistent_node
+    {
+      std::array<persistent_node_ptr, persistent_width> children;
+    };
+
+    struct vector_leaf final : public persistent_node
+    {
+      std::array<value, persistent_width> elements;
+    };
+
+    /**
+     * Returns copy of given vector node where element at given index has
+     * given value. Missing nodes on the path are created, which is how the
+     * vector grows.
+     */
+    inline persistent_node_ptr
+    vector_assoc(
+      const persistent_node* node,
+      unsigned shift,
+      std::size_t index,
+      const value& v,
+      std::pmr::memory_resource* resource
+    )
+    {
+      if (shift == 0)
+      {
+        const auto result = node
+          ? make_node<vector_leaf>(
+            resource,
+            static_cast<const vector_leaf&>(*node)
+          )
+          : make_node<vector_leaf>(resource);
+
+        result->elements[index & persistent_mask] = v;
+
+        return result;
+      }
+
+      const auto result = node
+        ? make_node<vector_branch>(
+          resource,
+          static_cast<const vector_branch&>(*node)
+        )
+        : make_node<vector_branch>(resource);
+      auto& child = result->children[(index >> shift) & persistent_mask];
+
+      child = vector_assoc(
+        child.get(),
+        shift - persistent_bits,
+        index,
+        v,
+        resource
+      );
+
+      return result;
+    }
+
+    /**
+     * Property of a persistent map. Leaves are shared between versions of
+     * the map just like nodes are, so keys are never copied by updates.
+     */
+    struct map_leaf final : public persistent_node
+    {
+      explicit map_leaf(
+        std::size_t hash,
+        std::u32string_view key,
+        const value& mapped,
+        std::pmr::memory_resource* resource
+      )
+        : hash(hash)
+        , key(key, resource)
+        , mapped(mapped) {}
+
+      const std::size_t hash;
+      const object::key_type key;
+      const value mapped;
+    };
+
+    /**
+     * Node of a hash array mapped trie. Slots are stored compactly, so that
+     * `bitmap` tells which of the 32 possible slots are in use and `nodemap`
+     * which of them contain sub nodes instead of leaves. Once all bits of
+     * the hash have been consumed, the node contains just a list of leaves
+     * which have the same hash.
+     */
+    struct map_node final : public persistent_node
+    {
+      explicit map_node(std::pmr::memory_resource* resource)
+        : slots(resource) {}
+
+      explicit map_node(
+        const map_node& that,
+        std::pmr::memory_resource* resource
+      )
+        : bitmap(that.bitmap)
+        , nodemap(that.nodemap)
+        , slots(that.slots, resource) {}
+
+      std::uint32_t bitmap = 0;
+      std::uint32_t nodemap = 0;
+      std::pmr::vector<persistent_node_ptr> slots;
+    };
+
+    using map_node_ptr = std::shared_ptr<const map_node>;
+
+    inline std::uint32_t
+    map_bit(std::size_t hash, unsigned shift)
+    {
+      return std::uint32_t(1) << ((hash >> shift) & persistent_mask);
+    }
+
+    /**
+     * Returns position of the slot marked by given bit in the compact slot
+     * storage, by counting the bits below it.
+     */
+    inline std::size_t
+    map_index(std::uint32_t bitmap, std::uint32_t bit)
+    {
+      auto x = bitmap & (bit - 1);
+
+      x = x - ((x >> 1) & 0x55555555);
+      x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+
+      return (((x + (x >> 4)) & 0x0f0f0f0f) * 0x01010101) >> 24;
+    }
+
+    inline const map_leaf&
+    as_leaf(const persistent_node_ptr& slot)
+    {
+      return static_cast<const map_leaf&>(*slot);
+    }
+
+    inline const map_node*
+    as_map_node(const persistent_node_ptr& slot)
+    {
+      return static_cast<const map_node*>(slot.get());
+    }
+
+    inline const map_leaf*
+    map_find(
+      const map_node* node,
+      std::size_t hash,
+      std::u32string_view key
+    )
+    {
+      for (unsigned shift = 0; node; shift += persistent_bits)
+      {
+        if (shift >= persistent_hash_bits)
+        {
+          for (const auto& slot : node->slots)
+          {
+            if (as_leaf(slot).key == key)
+            {
+              return &as_leaf(slot);
+            }
+          }
+
+          return nullptr;
+        }
+
+        const auto bit = map_bit(hash, shift);
+
+        if (!(node->bitmap & bit))
+        {
+          return nullptr;
+        }
+
+        const auto& slot = node->slots[map_index(node->bitmap, bit)];
+
+        if (node->nodemap & bit)
+        {
+          node = as_map_node(slot);
+        } else {
+          const auto& leaf = as_leaf(slot);
+
+          return leaf.hash == hash && leaf.key == key ? &leaf : nullptr;
+        }
+      }
+
+      return nullptr;
+    }
+
+    /**
+     * Returns copy of given map node with given leaf inserted into it,
+     * replacing existing leaf with the same key. `added` is set when the
+     * map grows.
+     */
+    inline map_node_ptr
+    map_assoc(
+      const map_node* node,
+      unsigned shift,
+      const std::shared_ptr<const map_leaf>& leaf,
+      std::pmr::memory_resource* resource,
+      bool& added
+    )
+    {
+      const auto result = node
+        ? make_node<map_node>(resource, *node, resource)
+        : make_node<map_node>(resource, resource);
+
+      if (shift >= persistent_hash_bits)
+      {
+        for (auto& slot : result->slots)
+        {
+          if (as_leaf(slot).key == leaf->key)
+          {
+            slot = leaf;
+
+            return result;
+          }
+        }
+        result->slots.push_back(leaf);
+        added = true;
+
+        return result;
+      }
+
+      const auto bit = map_bit(leaf->hash, shift);
+      const auto index = map_index(result->bitmap, bit);
+      auto slot = std::begin(result->slots) + index;
+
+      if (!(result->bitmap & bit))
+      {
+        result->slots.insert(slot, leaf);
+        result->bitmap |= bit;
+        added = true;
+      }
+      else if (result->nodemap & bit)
+      {
+        *slot = map_assoc(
+          as_map_node(*slot),
+          shift + persistent_bits,
+          leaf,
+          resource,
+          added
+        );
+      }
+      else if (
+        as_leaf(*slot).hash == leaf->hash &&
+        as_leaf(*slot).key == leaf->key
+      )
+      {
+        *slot = leaf;
+      } else {
+        // Two different keys share this slot, so they are moved into a sub
+        // node which looks at the next bits of their hashes.
+        const auto existing = std::static_pointer_cast<const map_leaf>(*slot);
+        bool ignored = false;
+        const auto child = map_assoc(
+          nullptr,
+          shift + persistent_bits,
+          existing,
+          resource,
+          ignored
+        );
+
+        *slot = map_assoc(
+          child.get(),
+          shift + persistent_bits,
+          leaf,
+          resource,
+          added
+        );
+        result->nodemap |= bit;
+      }
+
+      return result;
+    }
+
+    /**
+     * Returns copy of given map node without leaf of given key, or null
+     * pointer if the node would become empty. `removed` is set when the key
+     * was found; otherwise the return value is meaningless and the original
+     * node should be used as it is.
+     */
+    inline map_node_ptr
+    map_dissoc(
+      const map_node* node,
+      unsigned shift,
+      std::size_t hash,
+      std::u32string_view key,
+      std::pmr::memory_resource* resource,
+      bool& removed
+    )
+    {
+      if (shift >= persistent_hash_bits)
+      {
+        for (std::size_t i = 0; i < node->slots.size(); ++i)
+        {
+          if (as_leaf(node->slots[i]).key == key)
+          {
+            const auto result = make_node<map_node>(resource, *node, resource);
+
+            result->slots.erase(std::begin(result->slots) + i);
+            removed = true;
+
+            return result->slots.empty() ? nullptr : result;
+          }
+        }
+
+        return nullptr;
+      }
+
+      const auto bit = map_bit(hash, shift);
+
+      if (!(node->bitmap & bit))
+      {
+        return nullptr;
+      }
+
+      const auto index = map_index(node->bitmap, bit);
+      const auto& slot = node->slots[index];
+      persistent_node_ptr replacement;
+      bool is_node = false;
+
+      if (node->nodemap & bit)
+      {
+        const auto child = map_dissoc(
+          as_map_node(slot),
+          shift + persistent_bits,
+          hash,
+          key,
+          resource,
+          removed
+        );
+
+        if (!removed)
+        {
+          return nullptr;
+        }
+        // Sub node left with just one leaf is replaced with the leaf.
+        else if (child && !child->nodemap && child->slots.size() == 1)
+        {
+          replacement = child->slots[0];
+        }
+        else if (child)
+        {
+          replacement = child;
+          is_node = true;
+        }
+      }
+      else if (as_leaf(slot).hash != hash || as_leaf(slot).key != key)
+      {
+        return nullptr;
+      } else {
+        removed = true;
+      }
+
+      const auto result = make_node<map_node>(resource, *node, resource);
+
+      if (replacement)
+      {
+        result->slots[index] = replacement;
+        if (!is_node)
+        {
+          result->nodemap &= ~bit;
+        }
+      } else {
+        result->slots.erase(std::begin(result->slots) + index);
+        result->bitmap &= ~bit;
+        result->nodemap &= ~bit;
+      }
+
+      return result->slots.empty() ? nullptr : result;
+    }
+
+    template<class Callback>
+    void
+    map_for_each(const map_node* node, Callback& callback)
+    {
+      std::size_t n = 0;
+
+      // Node of leaves with colliding hashes has no bitmap.
+      if (!node->bitmap)
+      {
+        for (const auto& slot : node->slots)
+        {
+          callback(
+            std::u32string_view(as_leaf(slot).key),
+            as_leaf(slot).mapped
+          );
+        }
+
+        return;
+      }
+      for (std::size_t i = 0; i < persistent_width; ++i)
+      {
+        const auto bit = std::uint32_t(1) << i;
+
+        if (!(node->bitmap & bit))
+        {
+          continue;
+        }
+
+        const auto& slot = node->slots[n++];
+
+        if (node->nodemap & bit)
+        {
+          map_for_each(as_map_node(slot), callback);
+        } else {
+          callback(
+            std::u32string_view(as_leaf(slot).key),
+            as_leaf(slot).mapped
+          );
+        }
+      }
+    }
+  }
+
+  /**
+   * Immutable array with structural sharing. Elements are stored in a trie
+   * of 32 element nodes, so replacing or appending an element copies only
+   * the nodes on the path to it and takes logarithmic time, no matter how
+   * large the array is. Every version of the array shares all other nodes
+   * with the previous one.
+   *
+   * Persistent arrays are meant for keeping large collections which are
+   * updated incrementally. They are converted into JSON arrays with
+   * `to_array()` when needed.
+   */
+  class persistent_array final
+  {
+  public:
+    explicit persistent_array(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+      : m_resource(resource)
+      , m_size(0)
+      , m_shift(0) {}
+
+    /**
+     * Constructs persistent array from elements of given JSON array, using
+     * the same memory resource.
+     */
+    explicit persistent_array(const array& arr)
+      : persistent_array(arr.elements().get_allocator().resource())
+    {
+      using namespace internal;
+      const auto& elements = arr.elements();
+      std::vector<persistent_node_ptr> nodes;
+
+      for (std::size_t i = 0; i < elements.size(); i += persistent_width)
+      {
+        const auto leaf = make_node<vector_leaf>(m_resource);
+
+        for (std::size_t j = 0; j < persistent_width; ++j)
+        {
+          if (i + j < elements.size())
+          {
+            leaf->elements[j] = elements[i + j];
+          }
+        }
+        nodes.push_back(leaf);
+      }
+      while (nodes.size() > 1)
+      {
+        std::vector<persistent_node_ptr> parents;
+
+        for (std::size_t i = 0; i < nodes.size(); i += persistent_width)
+        {
+          const auto branch = make_node<vector_branch>(m_resource);
+
+          for (std::size_t j = 0; j < persistent_width; ++j)
+          {
+            if (i + j < nodes.size())
+            {
+              branch->children[j] = nodes[i + j];
+            }
+          }
+          parents.push_back(branch);
+        }
+        nodes.swap(parents);
+        m_shift += persistent_bits;
+      }
+      if (!nodes.empty())
+      {
+        m_root = nodes[0];
+      }
+      m_size = elements.size();
+    }
+
+    inline std::size_t size() const
+    {
+      return m_size;
+    }
+
+    inline bool empty() const
+    {
+      return !m_size;
+    }
+
+    inline std::pmr::memory_resource* resource() const
+    {
+      return m_resource;
+    }
+
+    /**
+     * Returns element at given index. No bounds checking is done.
+     */
+    const value& operator[](std::size_t index) const
+    {
+      return leaf_for(index).elements[index & internal::persistent_mask];
+    }
+
+    /**
+     * Returns new version of the array where element at given index has
+     * been replaced with given value. The index must be within bounds.
+     */
+    persistent_array set(std::size_t index, const value& v) const
+    {
+      if ((*this)[index] == v)
+      {
+        return *this;
+      }
+
+      return persistent_array(
+        m_resource,
+        m_size,
+        m_shift,
+        internal::vector_assoc(m_root.get(), m_shift, index, v, m_resource)
+      );
+    }
+
+    /**
+     * Returns new version of the array with given value appended to the end
+     * of it.
+     */
+    persistent_array push_back(const value& v) const
+    {
+      using namespace internal;
+
+      // Root is full, so the trie grows by one level.
+      if (m_root && m_size == std::size_t(1) << (m_shift + persistent_bits))
+      {
+        const auto root = make_node<vector_branch>(m_resource);
+
+        root->children[0] = m_root;
+        root->children[1] = vector_assoc(
+          nullptr,
+          m_shift,
+          m_size,
+          v,
+          m_resource
+        );
+
+        return persistent_array(
+          m_resource,
+          m_size + 1,
+          m_shift + persistent_bits,
+          root
+        );
+      }
+
+      return persistent_array(
+        m_resource,
+        m_size + 1,
+        m_shift,
+        vector_assoc(m_root.get(), m_shift, m_size, v, m_resource)
+      );
+    }
+
+    /**
+     * Calls given callback with each element of the array, in order.
+     */
+    template<class Callback>
+    void for_each(Callback callback) const
+    {
+      using internal::persistent_width;
+
+      for (std::size_t i = 0; i < m_size; i += persistent_width)
+      {
+        const auto& leaf = leaf_for(i);
+
+        for (std::size_t j = 0; j < persistent_width && i + j < m_size; ++j)
+        {
+          callback(leaf.elements[j]);
+        }
+      }
+    }
+
+    /**
+     * Converts the persistent array into JSON array, allocated from the
+     * memory resource of the persistent array.
+     */
+    array::ptr to_array() const
+    {
+      array::container_type elements(m_resource);
+
+      elements.reserve(m_size);
+      for_each([&elements](const value& element)
+      {
+        elements.push_back(element);
+      });
+
+      return internal::make_node<array>(m_resource, std::move(elements));
+    }
+
+  private:
+    explicit persistent_array(
+      std::pmr::memory_resource* resource,
+      std::size_t size,
+      unsigned shift,
+      internal::persistent_node_ptr root
+    )
+      : m_resource(resource)
+      , m_size(size)
+      , m_shift(shift)
+      , m_root(std::move(root)) {}
+
+    const internal::vector_leaf& leaf_for(std::size_t index) const
+    {
+      using namespace internal;
+      auto node = m_root.get();
+
+      for (auto shift = m_shift; shift > 0; shift -= persistent_bits)
+      {
+        node = static_cast<const vector_branch*>(node)->children[
+          (index >> shift) & persistent_mask
+        ].get();
+      }
+
+      return static_cast<const vector_leaf&>(*node);
+    }
+
+    std::pmr::memory_resource* m_resource;
+    std::size_t m_size;
+    unsigned m_shift;
+    internal::persistent_node_ptr m_root;
+  };
+
+  /**
+   * Immutable object with structural sharing. Properties are stored in a
+   * hash array mapped trie, so adding, replacing or removing a property
+   * copies only the nodes on the path to it and takes logarithmic time, no
+   * matter how many properties the object has. Every version of the object
+   * shares all other nodes with the previous one.
+   *
+   * Properties are hashed with the same function as prehashed keys, so
+   * looking up properties with keys constructed from string literals does
+   * not hash the name at all.
+   */
+  class persistent_object final
+  {
+  public:
+    explicit persistent_object(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+      : m_resource(resource)
+      , m_size(0) {}
+
+    /**
+     * Constructs persistent object from properties of given JSON object,
+     * using the same memory resource.
+     */
+    explicit persistent_object(const object& obj)
+      : persistent_object(obj.properties().get_allocator().resource())
+    {
+      for (const auto& property : obj.properties())
+      {
+        *this = set(std::u32string_view(property.first), property.second);
+      }
+    }
+
+    inline std::size_t size() const
+    {
+      return m_size;
+    }
+
+    inline bool empty() const
+    {
+      return !m_size;
+    }
+
+    inline std::pmr::memory_resource* resource() const
+    {
+      return m_resource;
+    }
+
+    /**
+     * Looks up property with given name. Returns pointer to value of the
+     * property, or null pointer if the object has no such property.
+     */
+    const value* find(const key& k) const
+    {
+      const auto leaf = internal::map_find(m_root.get(), k.hash(), k.name());
+
+      return leaf ? &leaf->mapped : nullptr;
+    }
+
+    /**
+     * Returns value of property with given name, or null if the object has
+     * no such property.
+     */
+    value get(const key& k) const
+    {
+      const auto result = find(k);
+
+      return result ? *result : nullptr;
+    }
+
+    /**
+     * Returns new version of the object where given property has given
+     * value, either replacing an existing property or adding a new one. If
+     * the property already has exactly the same value, the object itself is
+     * returned.
+     */
+    persistent_object set(const key& k, const value& v) const
+    {
+      if (const auto existing = find(k); existing && *existing == v)
+      {
+        return *this;
+      }
+
+      bool added = false;
+      auto root = internal::map_assoc(
+        m_root.get(),
+        0,
+        internal::make_node<internal::map_leaf>(
+          m_resource,
+          k.hash(),
+          k.name(),
+          v,
+          m_resource
+        ),
+        m_resource,
+        added
+      );
+
+      return persistent_object(
+        m_resource,
+        added ? m_size + 1 : m_size,
+        std::move(root)
+      );
+    }
+
+    /**
+     * Returns new version of the object without given property. If the
+     * object does not have such property, the object itself is returned.
+     */
+    persistent_object erase(const key& k) const
+    {
+      bool removed = false;
+
+      if (!m_root)
+      {
+        return *this;
+      }
+
+      auto root = internal::map_dissoc(
+        m_root.get(),
+        0,
+        k.hash(),
+        k.name(),
+        m_resource,
+        removed
+      );
+
+      if (!removed)
+      {
+        return *this;
+      }
+
+      return persistent_object(m_resource, m_size - 1, std::move(root));
+    }
+
+    /**
+     * Calls given callback with name and value of each property of the
+     * object, in unspecified order.
+     */
+    template<class Callback>
+    void for_each(Callback callback) const
+    {
+      if (m_root)
+      {
+        internal::map_for_each(m_root.get(), callback);
+      }
+    }
+
+    /**
+     * Converts the persistent object into JSON object, allocated from the
+     * memory resource of the persistent object.
+     */
+    object::ptr to_object() const
+    {
+      object::container_type properties(m_resource);
+
+      properties.reserve(m_size);
+      for_each([&](std::u32string_view name, const value& v)
+      {
+        properties.emplace(object::key_type(name, m_resource), v);
+      });
+
+      return internal::make_node<object>(m_resource, std::move(properties));
+    }
+
+  private:
+    explicit persistent_object(
+      std::pmr::memory_resource* resource,
+      std::size_t size,
+      internal::map_node_ptr root
+    )
+      : m_resource(resource)
+      , m_size(size)
+      , m_root(std::move(root)) {}
+
+    std::pmr::memory_resource* m_resource;
+    std::size_t m_size;
+    internal::map_node_ptr m_root;
+  };
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+# error "Intrusive reference counting does not support threads."
+#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  /**
+   * Destroys JSON values in a background thread, so that the thread
+   * releasing a large tree does not have to pay for freeing all of it's
+   * nodes. Values handed to the queue are collected into batches which the
+   * background thread then destroys.
+   *
+   * Values allocated from a memory resource which is not thread safe, such
+   * as `std::pmr::monotonic_buffer_resource`, must not be handed to the
+   * queue unless nothing else uses the resource at the same time, and the
+   * resource must outlive the queue or a call to `flush()`.
+   */
+  class release_queue
+  {
+  public:
+    release_queue()
+      : m_stopped(false)
+      , m_busy(false)
+      , m_thread([this]() { work(); }) {}
+
+    /**
+     * Destroys all values still in the queue and stops the background
+     * thread.
+     */
+    ~release_queue()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_stopped = true;
+      }
+      m_condition.notify_all();
+      m_thread.join();
+    }
+
+    release_queue(const release_queue&) = delete;
+    release_queue(release_queue&&) = delete;
+    void operator=(const release_queue&) = delete;
+    void operator=(release_queue&&) = delete;
+
+    /**
+     * Hands given value to the background thread for destruction. Scalars
+     * and values which are still referenced from somewhere else are
+     * released immediately instead, as that only decrements their reference
+     * count.
+     */
+    void release(value v)
+    {
+      if (!internal::is_container(v) || v.use_count() > 1)
+      {
+        return;
+      }
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_pending.push_back(std::move(v));
+      }
+      m_condition.notify_one();
+    }
+
+    /**
+     * Waits until all values handed to the queue so far have been
+     * destroyed.
+     */
+    void flush()
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      m_flushed.wait(lock, [this]() { return m_pending.empty() && !m_busy; });
+    }
+
+  private:
+    void work()
+    {
+      std::vector<value> batch;
+      std::unique_lock<std::mutex> lock(m_mutex);
+
+      for (;;)
+      {
+        m_condition.wait(lock, [this]()
+        {
+          return m_stopped || !m_pending.empty();
+        });
+        if (m_pending.empty())
+        {
+          return;
+        }
+        batch.swap(m_pending);
+        m_busy = true;
+        lock.unlock();
+        batch.clear();
+        lock.lock();
+        m_busy = false;
+        m_flushed.notify_all();
+      }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_flushed;
+    std::vector<value> m_pending;
+    bool m_stopped;
+    bool m_busy;
+    std::thread m_thread;
+  };
+}
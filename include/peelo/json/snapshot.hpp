@@ -0,0 +1,760 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+// Keep <windows.h> from defining `min` and `max` macros, which would break
+// standard library and this library's own headers included after it.
+# if !defined(NOMINMAX)
+#  define NOMINMAX
+#  define PEELO_JSON_UNDEF_NOMINMAX
+# endif
+# if !defined(WIN32_LEAN_AND_MEAN)
+#  define WIN32_LEAN_AND_MEAN
+#  define PEELO_JSON_UNDEF_WIN32_LEAN_AND_MEAN
+# endif
+# include <windows.h>
+# if defined(PEELO_JSON_UNDEF_NOMINMAX)
+#  undef NOMINMAX
+#  undef PEELO_JSON_UNDEF_NOMINMAX
+# endif
+# if defined(PEELO_JSON_UNDEF_WIN32_LEAN_AND_MEAN)
+#  undef WIN32_LEAN_AND_MEAN
+#  undef PEELO_JSON_UNDEF_WIN32_LEAN_AND_MEAN
+# endif
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include <peelo/json/exception.hpp>
+#include <peelo/json/value.hpp>
+#include <peelo/result.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    inline constexpr char snapshot_magic[8] =
+    {
+      'P', 'J', 'S', 'N', 'A', 'P', 0, 0,
+    };
+
+    inline constexpr std::uint32_t snapshot_version = 1;
+
+    /**
+     * Written in native byte order, so that snapshots written on machine
+     * with different byte order can be detected.
+     */
+    inline constexpr std::uint32_t snapshot_byte_order = 0x01020304;
+
+    /**
+     * Header at the beginning of a snapshot. All offsets are relative to
+     * the beginning of the snapshot, and every node is aligned to eight
+     * bytes.
+     */
+    struct snapshot_header
+    {
+      char magic[8];
+      std::uint32_t version;
+      std::uint32_t byte_order;
+      std::uint64_t size;
+      std::uint64_t root;
+    };
+
+    /**
+     * Header of a node. Size is the number of elements, properties or code
+     * points, or value of a boolean. For numbers, `kind` is the way the
+     * number is stored, and the number follows the header as eight bytes.
+     * Strings are followed by their code points in UTF-32, arrays by offsets
+     * of their elements and objects by pairs of offsets of keys and values,
+     * sorted by the keys. Offset zero refers to null.
+     */
+    struct snapshot_node
+    {
+      std::uint32_t type;
+      std::uint32_t kind;
+      std::uint64_t size;
+    };
+
+    class snapshot_writer
+    {
+    public:
+      snapshot_writer()
+      {
+        m_output.resize(sizeof(snapshot_header));
+      }
+
+      std::vector<std::uint8_t> write(const value& root)
+      {
+        snapshot_header header;
+
+        std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+        header.version = snapshot_version;
+        header.byte_order = snapshot_byte_order;
+        header.root = write_value(root);
+        header.size = m_output.size();
+        std::memcpy(m_output.data(), &header, sizeof(header));
+
+        return std::move(m_output);
+      }
+
+    private:
+      template<class T>
+      void append(const T& data)
+      {
+        const auto offset = m_output.size();
+
+        m_output.resize(offset + sizeof(T));
+        std::memcpy(m_output.data() + offset, &data, sizeof(T));
+      }
+
+      std::uint64_t begin_node(
+        enum type type,
+        std::uint32_t kind,
+        std::uint64_t size
+      )
+      {
+        const auto offset = m_output.size();
+
+        append(snapshot_node{ static_cast<std::uint32_t>(type), kind, size });
+
+        return offset;
+      }
+
+      /**
+       * Pads the output to eight byte boundary.
+       */
+      void align()
+      {
+        m_output.resize((m_output.size() + 7) & ~std::size_t(7));
+      }
+
+      std::uint64_t write_string(std::u32string_view value)
+      {
+        const auto offset = begin_node(type::string, 0, value.length());
+        const auto data = m_output.size();
+
+        m_output.resize(data + value.length() * sizeof(char32_t));
+        std::memcpy(
+          m_output.data() + data,
+          value.data(),
+          value.length() * sizeof(char32_t)
+        );
+        align();
+
+        return offset;
+      }
+
+      /**
+       * Property names are written only once, no matter how many objects
+       * use them.
+       */
+      std::uint64_t write_key(std::u32string_view key)
+      {
+        const auto it = m_keys.find(key);
+
+        if (it != std::end(m_keys))
+        {
+          return it->second;
+        }
+
+        return m_keys[key] = write_string(key);
+      }
+
+      std::uint64_t write_value(const value& v)
+      {
+        switch (type_of(v))
+        {
+          case type::array:
+            {
+              const auto& elements = as_ref<array>(v).elements();
+              std::vector<std::uint64_t> offsets;
+
+              offsets.reserve(elements.size());
+              for (const auto& element : elements)
+              {
+                offsets.push_back(write_value(element));
+              }
+
+              const auto offset = begin_node(type::array, 0, offsets.size());
+
+              for (const auto element : offsets)
+              {
+                append(element);
+              }
+
+              return offset;
+            }
+
+          case type::boolean:
+            return begin_node(type::boolean, 0, as_ref<boolean>(v).value());
+
+          case type::null:
+            return 0;
+
+          case type::number:
+            {
+              const auto& n = as_ref<number>(v);
+              const auto kind = n.kind() == number::kind::digits
+                ? number::kind::floating
+                : n.kind();
+              const auto offset = begin_node(
+                type::number,
+                static_cast<std::uint32_t>(kind),
+                0
+              );
+
+              if (kind == number::kind::int64)
+              {
+                append(*n.as_int64());
+              }
+              else if (kind == number::kind::uint64)
+              {
+                append(*n.as_uint64());
+              } else {
+                append(n.value());
+              }
+
+              return offset;
+            }
+
+          case type::object:
+            {
+              const auto& properties = as_ref<object>(v).properties();
+              std::vector<const object::value_type*> sorted;
+              std::vector<std::uint64_t> offsets;
+
+              sorted.reserve(properties.size());
+              for (const auto& property : properties)
+              {
+                sorted.push_back(&property);
+              }
+              std::sort(
+                std::begin(sorted),
+                std::end(sorted),
+                [](const auto a, const auto b)
+                {
+                  return a->first < b->first;
+                }
+              );
+              offsets.reserve(sorted.size() * 2);
+              for (const auto property : sorted)
+              {
+                offsets.push_back(write_key(property->first));
+                offsets.push_back(write_value(property->second));
+              }
+
+              const auto offset = begin_node(type::object, 0, sorted.size());
+
+              for (const auto element : offsets)
+              {
+                append(element);
+              }
+
+              return offset;
+            }
+
+          case type::string:
+            return write_string(as_ref<string>(v).value());
+        }
+
+        return 0;
+      }
+
+      std::vector<std::uint8_t> m_output;
+      std::unordered_map<std::u32string_view, std::uint64_t> m_keys;
+    };
+  }
+
+  /**
+   * Read only handle to a value inside a snapshot. The handle points
+   * directly into memory of the snapshot, so it's only valid as long as the
+   * snapshot is. No type checking is done by the accessors, so check the
+   * type with `type()` first.
+   */
+  class snapshot_value
+  {
+  public:
+    explicit snapshot_value(const std::uint8_t* data, std::uint64_t offset)
+      : m_data(data)
+      , m_offset(offset) {}
+
+    inline enum type type() const
+    {
+      return m_offset ? static_cast<enum type>(node().type) : type::null;
+    }
+
+    inline bool as_boolean() const
+    {
+      return node().size != 0;
+    }
+
+    /**
+     * Returns value of a number as double.
+     */
+    inline double as_number() const
+    {
+      switch (static_cast<enum number::kind>(node().kind))
+      {
+        case number::kind::int64:
+          return static_cast<double>(payload<std::int64_t>(0));
+
+        case number::kind::uint64:
+          return static_cast<double>(payload<std::uint64_t>(0));
+
+        default:
+          return payload<double>(0);
+      }
+    }
+
+    /**
+     * Returns code points of a string, without copying them.
+     */
+    inline std::u32string_view as_string() const
+    {
+      return std::u32string_view(
+        reinterpret_cast<const char32_t*>(
+          m_data + m_offset + sizeof(internal::snapshot_node)
+        ),
+        node().size
+      );
+    }
+
+    /**
+     * Returns number of elements in an array or properties in an object.
+     */
+    inline std::size_t size() const
+    {
+      return node().size;
+    }
+
+    /**
+     * Returns element of an array at given index. No bounds checking is
+     * done.
+     */
+    inline snapshot_value operator[](std::size_t index) const
+    {
+      return snapshot_value(m_data, payload<std::uint64_t>(index));
+    }
+
+    /**
+     * Returns name of property of an object at given index. Properties are
+     * sorted by their names.
+     */
+    inline std::u32string_view key(std::size_t index) const
+    {
+      return snapshot_value(
+        m_data,
+        payload<std::uint64_t>(index * 2)
+      ).as_string();
+    }
+
+    /**
+     * Returns value of property of an object at given index.
+     */
+    inline snapshot_value value(std::size_t index) const
+    {
+      return snapshot_value(m_data, payload<std::uint64_t>(index * 2 + 1));
+    }
+
+    /**
+     * Looks up property of an object with binary search.
+     */
+    std::optional<snapshot_value> find(std::u32string_view name) const
+    {
+      std::size_t low = 0;
+      std::size_t high = size();
+
+      while (low < high)
+      {
+        const auto middle = low + (high - low) / 2;
+        const auto comparison = key(middle).compare(name);
+
+        if (comparison == 0)
+        {
+          return value(middle);
+        }
+        else if (comparison < 0)
+        {
+          low = middle + 1;
+        } else {
+          high = middle;
+        }
+      }
+
+      return std::nullopt;
+    }
+
+    /**
+     * Copies the value and all of it's descendants into ordinary JSON
+     * values allocated from given memory resource.
+     */
+    peelo::json::value to_value(
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    ) const
+    {
+      switch (type())
+      {
+        case type::array:
+          {
+            array::container_type elements(resource);
+
+            elements.reserve(size());
+            for (std::size_t i = 0; i < size(); ++i)
+            {
+              elements.push_back((*this)[i].to_value(resource));
+            }
+
+            return internal::make_node<array>(resource, std::move(elements));
+          }
+
+        case type::boolean:
+          return boolean::make(as_boolean(), resource);
+
+        case type::null:
+          return nullptr;
+
+        case type::number:
+          switch (static_cast<enum number::kind>(node().kind))
+          {
+            case number::kind::int64:
+              return number::make(payload<std::int64_t>(0), resource);
+
+            case number::kind::uint64:
+              return number::make(payload<std::uint64_t>(0), resource);
+
+            default:
+              return number::make(payload<double>(0), resource);
+          }
+
+        case type::object:
+          {
+            object::container_type properties(resource);
+
+            for (std::size_t i = 0; i < size(); ++i)
+            {
+              properties.insert_or_assign(
+                object::key_type(key(i), resource),
+                value(i).to_value(resource)
+              );
+            }
+
+            return internal::make_node<object>(
+              resource,
+              std::move(properties)
+            );
+          }
+
+        case type::string:
+          return string::make(as_string(), resource);
+      }
+
+      return nullptr;
+    }
+
+  private:
+    inline internal::snapshot_node node() const
+    {
+      internal::snapshot_node result;
+
+      std::memcpy(&result, m_data + m_offset, sizeof(result));
+
+      return result;
+    }
+
+    template<class T>
+    inline T payload(std::size_t index) const
+    {
+      T result;
+
+      std::memcpy(
+        &result,
+        m_data + m_offset + sizeof(internal::snapshot_node) + index * 8,
+        sizeof(result)
+      );
+
+      return result;
+    }
+
+    const std::uint8_t* m_data;
+    std::uint64_t m_offset;
+  };
+
+  /**
+   * Position independent binary snapshot of a JSON value, which can be
+   * navigated in place without parsing or allocating anything. Snapshots
+   * are opened from files with memory mapping, so the pages are shared by
+   * every process that opens the same file, or from memory such as shared
+   * memory segments.
+   *
+   * Snapshots are stored in native byte order, and only their header is
+   * validated when they are opened, so they must come from a trusted
+   * source.
+   */
+  class snapshot
+  {
+  public:
+    using open_result = result<std::shared_ptr<const snapshot>, parse_error>;
+
+    snapshot(const snapshot&) = delete;
+    snapshot(snapshot&&) = delete;
+    void operator=(const snapshot&) = delete;
+    void operator=(snapshot&&) = delete;
+
+    ~snapshot()
+    {
+#if defined(_WIN32)
+      if (m_mapping)
+      {
+        UnmapViewOfFile(m_data);
+        CloseHandle(m_mapping);
+      }
+#else
+      if (m_mapped)
+      {
+        ::munmap(const_cast<std::uint8_t*>(m_data), m_size);
+      }
+#endif
+    }
+
+    /**
+     * Writes snapshot of given JSON value.
+     */
+    static std::vector<std::uint8_t> write(const value& v)
+    {
+      return internal::snapshot_writer().write(v);
+    }
+
+    /**
+     * Opens snapshot from given memory, which must be aligned to eight bytes
+     * and stay valid as long as the snapshot is used.
+     */
+    static open_result view(const void* data, std::size_t size)
+    {
+      std::shared_ptr<snapshot> result(new snapshot(
+        static_cast<const std::uint8_t*>(data),
+        size
+      ));
+
+      return validate(result);
+    }
+
+    /**
+     * Opens snapshot file by mapping it into memory.
+     */
+    static open_result open(const std::string& path)
+    {
+#if defined(_WIN32)
+      const auto file = CreateFileA(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr
+      );
+      LARGE_INTEGER size;
+
+      if (file == INVALID_HANDLE_VALUE)
+      {
+        return error("Unable to open snapshot file.");
+      }
+      else if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+      {
+        CloseHandle(file);
+
+        return error("Unable to open snapshot file.");
+      }
+
+      const auto mapping = CreateFileMappingA(
+        file,
+        nullptr,
+        PAGE_READONLY,
+        0,
+        0,
+        nullptr
+      );
+
+      CloseHandle(file);
+      if (!mapping)
+      {
+        return error("Unable to map snapshot file.");
+      }
+
+      const auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+      if (!data)
+      {
+        CloseHandle(mapping);
+
+        return error("Unable to map snapshot file.");
+      }
+
+      std::shared_ptr<snapshot> result(new snapshot(
+        static_cast<const std::uint8_t*>(data),
+        static_cast<std::size_t>(size.QuadPart)
+      ));
+
+      result->m_mapping = mapping;
+#else
+      const auto fd = ::open(path.c_str(), O_RDONLY);
+      struct stat info;
+
+      if (fd < 0)
+      {
+        return error("Unable to open snapshot file.");
+      }
+      else if (::fstat(fd, &info) != 0 || info.st_size <= 0)
+      {
+        ::close(fd);
+
+        return error("Unable to open snapshot file.");
+      }
+
+      const auto size = static_cast<std::size_t>(info.st_size);
+      const auto data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+      ::close(fd);
+      if (data == MAP_FAILED)
+      {
+        return error("Unable to map snapshot file.");
+      }
+
+      std::shared_ptr<snapshot> result(new snapshot(
+        static_cast<const std::uint8_t*>(data),
+        size
+      ));
+
+      result->m_mapped = true;
+#endif
+
+      return validate(result);
+    }
+
+    /**
+     * Returns the root value of the snapshot.
+     */
+    inline snapshot_value root() const
+    {
+      return snapshot_value(m_data, header().root);
+    }
+
+    inline const std::uint8_t* data() const
+    {
+      return m_data;
+    }
+
+    inline std::size_t size() const
+    {
+      return m_size;
+    }
+
+  private:
+    explicit snapshot(const std::uint8_t* data, std::size_t size)
+      : m_data(data)
+      , m_size(size)
+#if defined(_WIN32)
+      , m_mapping(nullptr) {}
+#else
+      , m_mapped(false) {}
+#endif
+
+    inline internal::snapshot_header header() const
+    {
+      internal::snapshot_header result;
+
+      std::memcpy(&result, m_data, sizeof(result));
+
+      return result;
+    }
+
+    static open_result error(const std::string& message)
+    {
+      return open_result::error({ { 1, 1 }, message });
+    }
+
+    static open_result validate(const std::shared_ptr<snapshot>& s)
+    {
+      if (
+        s->m_size < sizeof(internal::snapshot_header) ||
+        reinterpret_cast<std::uintptr_t>(s->m_data) % 8 != 0
+      )
+      {
+        return error("Snapshot is truncated or misaligned.");
+      }
+
+      const auto header = s->header();
+
+      if (
+        std::memcmp(
+          header.magic,
+          internal::snapshot_magic,
+          sizeof(header.magic)
+        ) != 0
+      )
+      {
+        return error("Not a snapshot.");
+      }
+      else if (header.byte_order != internal::snapshot_byte_order)
+      {
+        return error("Snapshot has different byte order.");
+      }
+      else if (header.version != internal::snapshot_version)
+      {
+        return error("Unsupported snapshot version.");
+      }
+      else if (header.size > s->m_size || header.root >= header.size)
+      {
+        return error("Snapshot is truncated.");
+      }
+
+      return open_result::ok(s);
+    }
+
+    const std::uint8_t* m_data;
+    const std::size_t m_size;
+#if defined(_WIN32)
+    HANDLE m_mapping;
+#else
+    bool m_mapped;
+#endif
+  };
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  /**
+   * Records the range of source code each value was parsed from. When given
+   * to the formatter, values found in the map are output by copying their
+   * original source text instead of formatting them again. Since values are
+   * immutable, any value found in the map is known to be unmodified, while
+   * values created when editing a parsed document are not in the map and
+   * are formatted normally.
+   *
+   * The map keeps every recorded value alive, including values dropped by
+   * the parser such as earlier duplicates of a property, so that values in
+   * it can be looked up by their address without a new value ever reusing
+   * the address of a recorded one.
+   */
+  class source_map
+  {
+  public:
+    /**
+     * Range of source code, as offset and length in code points.
+     */
+    struct span
+    {
+      std::size_t offset;
+      std::size_t length;
+    };
+
+    source_map() = default;
+    source_map(const source_map&) = delete;
+    source_map(source_map&&) = default;
+    void operator=(const source_map&) = delete;
+    source_map& operator=(source_map&&) = default;
+
+    /**
+     * Returns the source code which the values were parsed from.
+     */
+    inline const std::u32string& source() const
+    {
+      return m_source;
+    }
+
+    /**
+     * Returns number of values in the map.
+     */
+    inline std::size_t size() const
+    {
+      return m_spans.size();
+    }
+
+    /**
+     * Returns the range of source code given value was parsed from, or null
+     * pointer if the value is not in the map.
+     */
+    inline const span* find(const value& v) const
+    {
+      const auto it = m_spans.find(v.get());
+
+      return it != std::end(m_spans) ? &it->second.first : nullptr;
+    }
+
+    /**
+     * Returns source code which given value was parsed from, or empty view
+     * if the value is not in the map.
+     */
+    inline std::u32string_view text(const value& v) const
+    {
+      const auto s = find(v);
+
+      if (!s)
+      {
+        return std::u32string_view();
+      }
+
+      return std::u32string_view(m_source).substr(s->offset, s->length);
+    }
+
+    /**
+     * Removes everything from the map and starts recording values parsed
+     * from given source code.
+     */
+    void reset(const std::u32string& source)
+    {
+      m_source = source;
+      m_root = nullptr;
+      m_spans.clear();
+    }
+
+    /**
+     * Records the range of source code given value was parsed from.
+     */
+    void insert(const value& v, std::size_t offset, std::size_t length)
+    {
+      if (v)
+      {
+        m_spans[v.get()] = { { offset, length }, v };
+      }
+    }
+
+    /**
+     * Sets the root value of the parsed document.
+     */
+    void set_root(const value& root)
+    {
+      m_root = root;
+    }
+
+    /**
+     * Removes everything from the map.
+     */
+    void clear()
+    {
+      m_source.clear();
+      m_root = nullptr;
+      m_spans.clear();
+    }
+
+  private:
+    std::u32string m_source;
+    value m_root;
+    std::unordered_map<
+      const internal::base*,
+      std::pair<span, value>
+    > m_spans;
+  };
+}
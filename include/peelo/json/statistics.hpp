@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  /**
+   * Enumeration of the internal parsing routines whose running time is
+   * measured when statistics are enabled.
+   */
+  enum class parse_routine
+  {
+    array = 0,
+    boolean = 1,
+    escape_sequence = 2,
+    null = 3,
+    number = 4,
+    object = 5,
+    string = 6,
+    value = 7,
+  };
+
+  /**
+   * Statistics collected from a single parse. These are only gathered when
+   * the library is compiled with `PEELO_JSON_ENABLE_STATISTICS` defined;
+   * otherwise all of the instrumentation is compiled out of the parser.
+   */
+  struct parse_statistics
+  {
+    using duration = std::chrono::steady_clock::duration;
+
+    static constexpr std::size_t type_count = 6;
+    static constexpr std::size_t routine_count = 8;
+
+    /**
+     * Number of parsed values, indexed by their type.
+     */
+    std::size_t node_counts[type_count] = {};
+
+    /**
+     * Deepest level of nested arrays and objects encountered.
+     */
+    std::size_t max_depth = 0;
+
+    /**
+     * Number of bytes of decoded string data, including object keys.
+     */
+    std::size_t string_bytes = 0;
+
+    /**
+     * Time spent in each parsing routine. Times are inclusive, so time of an
+     * array also contains the time spent parsing its elements.
+     */
+    duration routine_times[routine_count] = {};
+
+    /**
+     * Number of value nodes allocated from the memory resource. Allocations
+     * made by containers and strings of the values are not included.
+     */
+    std::size_t node_allocations = 0;
+
+    /**
+     * Returns number of parsed values of given type.
+     */
+    inline std::size_t nodes(enum type t) const
+    {
+      return node_counts[static_cast<std::size_t>(t)];
+    }
+
+    /**
+     * Returns total number of parsed values.
+     */
+    inline std::size_t nodes() const
+    {
+      std::size_t total = 0;
+
+      for (const auto count : node_counts)
+      {
+        total += count;
+      }
+
+      return total;
+    }
+
+    /**
+     * Returns time spent in given parsing routine.
+     */
+    inline duration time(parse_routine routine) const
+    {
+      return routine_times[static_cast<std::size_t>(routine)];
+    }
+  };
+
+  /**
+   * Interface for receiving statistics of each parse, for example to feed
+   * them into a metrics system.
+   */
+  class parse_observer
+  {
+  public:
+    virtual void
+    on_parse(const parse_statistics& statistics) = 0;
+  };
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace peelo::json
+{
+  /**
+   * Work stealing thread pool used by the parallel algorithms. Each worker
+   * thread has it's own task queue. Tasks submitted from a worker thread go
+   * into it's own queue, where they are taken in LIFO order, while idle
+   * workers steal the oldest tasks from queues of other workers.
+   *
+   * Tasks submitted directly with `submit()` must not throw exceptions. Use
+   * `task_group` for tasks which may throw.
+   */
+  class thread_pool
+  {
+  public:
+    using task_type = std::function<void()>;
+
+    explicit thread_pool(
+      std::size_t size = std::thread::hardware_concurrency()
+    )
+      : m_queues(size > 0 ? size : 1)
+      , m_stopped(false)
+      , m_pending(0)
+      , m_next(0)
+    {
+      for (std::size_t i = 0; i < m_queues.size(); ++i)
+      {
+        m_threads.emplace_back([this, i]() { work(i); });
+      }
+    }
+
+    ~thread_pool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_stopped = true;
+      }
+      m_condition.notify_all();
+      for (auto& thread : m_threads)
+      {
+        thread.join();
+      }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool(thread_pool&&) = delete;
+    void operator=(const thread_pool&) = delete;
+    void operator=(thread_pool&&) = delete;
+
+    /**
+     * Returns number of worker threads in the pool.
+     */
+    inline std::size_t size() const
+    {
+      return m_threads.size();
+    }
+
+    /**
+     * Submits an task to be executed by the pool.
+     */
+    void submit(task_type task)
+    {
+      auto& queue = m_queues[current_pool == this
+        ? current_index
+        : m_next++ % m_queues.size()];
+
+      // Counter is incremented first, so that it never goes below zero when
+      // the task is taken from the queue before this function returns.
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        ++m_pending;
+      }
+      {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        queue.tasks.push_back(std::move(task));
+      }
+      m_condition.notify_one();
+    }
+
+    /**
+     * Executes one pending task in the calling thread, if there is any.
+     * Returns false if no task was found.
+     */
+    bool run_pending_task()
+    {
+      const auto own = current_pool == this ? current_index : 0;
+      task_type task;
+
+      for (std::size_t i = 0; i < m_queues.size(); ++i)
+      {
+        auto& queue = m_queues[(own + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.tasks.empty())
+        {
+          continue;
+        }
+        if (i == 0 && current_pool == this)
+        {
+          task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+        } else {
+          task = std::move(queue.tasks.front());
+          queue.tasks.pop_front();
+        }
+        break;
+      }
+
+      if (!task)
+      {
+        return false;
+      }
+      --m_pending;
+      task();
+
+      return true;
+    }
+
+  private:
+    struct queue
+    {
+      std::mutex mutex;
+      std::deque<task_type> tasks;
+    };
+
+    void work(std::size_t index)
+    {
+      current_pool = this;
+      current_index = index;
+
+      for (;;)
+      {
+        if (run_pending_task())
+        {
+          continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_condition.wait(lock, [this]()
+        {
+          return m_stopped || m_pending > 0;
+        });
+        if (m_stopped && m_pending == 0)
+        {
+          return;
+        }
+      }
+    }
+
+  private:
+    std::vector<queue> m_queues;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopped;
+    std::atomic<std::size_t> m_pending;
+    std::atomic<std::size_t> m_next;
+    static inline thread_local const thread_pool* current_pool = nullptr;
+    static inline thread_local std::size_t current_index = 0;
+  };
+
+  /**
+   * Group of tasks executed in a thread pool which can be waited for. While
+   * waiting, the waiting thread executes pending tasks of the pool, so task
+   * groups can be waited for from tasks of the same pool. When there is
+   * nothing to execute, the waiting thread blocks until the tasks of the
+   * group have completed.
+   *
+   * Exception thrown by a task is stored and rethrown by `wait()` once all
+   * tasks of the group have completed. When multiple tasks throw, only the
+   * first exception is kept.
+   */
+  class task_group
+  {
+  public:
+    explicit task_group(thread_pool& pool)
+      : m_pool(pool)
+      , m_pending(0) {}
+
+    /**
+     * Waits for the remaining tasks, discarding any exception thrown by
+     * them.
+     */
+    ~task_group()
+    {
+      wait_tasks();
+    }
+
+    task_group(const task_group&) = delete;
+    task_group(task_group&&) = delete;
+    void operator=(const task_group&) = delete;
+    void operator=(task_group&&) = delete;
+
+    /**
+     * Submits an task into the thread pool as part of this group.
+     */
+    void run(thread_pool::task_type task)
+    {
+      ++m_pending;
+      m_pool.submit([this, task = std::move(task)]()
+      {
+        try
+        {
+          task();
+        }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+
+          if (!m_exception)
+          {
+            m_exception = std::current_exception();
+          }
+        }
+
+        // Counter is decremented while holding the lock, so that the group
+        // cannot be destroyed before the waiting thread has been notified.
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (--m_pending == 0)
+        {
+          m_condition.notify_all();
+        }
+      });
+    }
+
+    /**
+     * Waits until all tasks of the group have been completed, and rethrows
+     * exception thrown by any of them.
+     */
+    void wait()
+    {
+      wait_tasks();
+      if (m_exception)
+      {
+        const auto exception = m_exception;
+
+        m_exception = nullptr;
+        std::rethrow_exception(exception);
+      }
+    }
+
+  private:
+    void wait_tasks()
+    {
+      static constexpr std::size_t spin_count = 64;
+      std::size_t spins = 0;
+
+      while (m_pending > 0)
+      {
+        if (m_pool.run_pending_task())
+        {
+          spins = 0;
+        }
+        else if (++spins < spin_count)
+        {
+          std::this_thread::yield();
+        } else {
+          std::unique_lock<std::mutex> lock(m_mutex);
+
+          // Wakes up periodically, since tasks submitted to the pool in the
+          // meantime are not signalled to the group.
+          m_condition.wait_for(
+            lock,
+            std::chrono::milliseconds(1),
+            [this]() { return m_pending == 0; }
+          );
+        }
+      }
+
+      // Last task may still be holding the lock while notifying.
+      std::lock_guard<std::mutex> lock(m_mutex);
+    }
+
+    thread_pool& m_pool;
+    std::atomic<std::size_t> m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::exception_ptr m_exception;
+  };
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <optional>
+
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    template<class Callback>
+    value transform(const value&, Callback&);
+
+    /**
+     * Transforms children of given array or object. If none of the
+     * children are replaced, the value itself is returned, otherwise a new
+     * container is allocated from the same memory resource as the original
+     * one.
+     */
+    template<class Callback>
+    value
+    transform_children(const value& v, Callback& callback)
+    {
+      const auto t = type_of(v);
+
+      if (t == type::array)
+      {
+        const auto& elements = as_ref<array>(v).elements();
+        const auto resource = elements.get_allocator().resource();
+        std::optional<array::container_type> result;
+
+        for (std::size_t i = 0; i < elements.size(); ++i)
+        {
+          auto element = transform(elements[i], callback);
+
+          if (!result && element != elements[i])
+          {
+            result.emplace(
+              std::begin(elements),
+              std::begin(elements) + i,
+              resource
+            );
+            result->reserve(elements.size());
+          }
+          if (result)
+          {
+            result->push_back(std::move(element));
+          }
+        }
+        if (result)
+        {
+          return make_node<array>(resource, std::move(*result));
+        }
+      }
+      else if (t == type::object)
+      {
+        const auto& properties = as_ref<object>(v).properties();
+        const auto resource = properties.get_allocator().resource();
+        std::optional<object::container_type> result;
+
+        for (const auto& property : properties)
+        {
+          auto replacement = transform(property.second, callback);
+
+          if (replacement == property.second)
+          {
+            continue;
+          }
+          if (!result)
+          {
+            result.emplace(properties, resource);
+          }
+          result->find(property.first)->second = std::move(replacement);
+        }
+        if (result)
+        {
+          return make_node<object>(resource, std::move(*result));
+        }
+      }
+
+      return v;
+    }
+
+    template<class Callback>
+    value
+    transform(const value& v, Callback& callback)
+    {
+      return callback(transform_children(v, callback));
+    }
+  }
+
+  /**
+   * Rebuilds given JSON value by passing it and all of it's descendants
+   * through given callback, which returns replacement for each value, or
+   * the value itself to keep it unchanged. Children are transformed before
+   * their parents, so the callback receives arrays and objects whose
+   * children have already been transformed, and can for example remove or
+   * rename properties of objects with `with()` and `without()`.
+   *
+   * Subtrees in which nothing was replaced are reused as they are, so only
+   * the arrays and objects on paths leading to replaced values are
+   * allocated again.
+   */
+  template<class Callback>
+  inline value
+  transform(const value& v, Callback callback)
+  {
+    return internal::transform(v, callback);
+  }
+}
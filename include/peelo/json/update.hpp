@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <optional>
+
+#include <peelo/json/persistent.hpp>
+#include <peelo/json/value.hpp>
+
+namespace peelo::json
+{
+  /**
+   * Returns copy of given object where given property has given value,
+   * either replacing an existing property or adding a new one. If the
+   * property already has exactly the same value, the object itself is
+   * returned.
+   *
+   * Every other property is shared with the original object, but the
+   * property table itself is copied, so the update takes time linear in the
+   * size of the object. Use `persistent_object` for large objects which are
+   * updated incrementally. New object is allocated from the same memory
+   * resource as the original one.
+   */
+  inline object::ptr
+  with(const object::ptr& obj, const key& k, const value& v)
+  {
+    const auto& properties = obj->properties();
+    const auto resource = properties.get_allocator().resource();
+
+    if (const auto existing = obj->find(k); existing && *existing == v)
+    {
+      return obj;
+    }
+
+    object::container_type result(properties, resource);
+
+    result.insert_or_assign(object::key_type(k.name(), resource), v);
+
+    return internal::make_node<object>(resource, std::move(result));
+  }
+
+  /**
+   * Returns copy of given object without given property. If the object does
+   * not have such property, the object itself is returned. Takes time linear
+   * in the size of the object.
+   */
+  inline object::ptr
+  without(const object::ptr& obj, const key& k)
+  {
+    const auto& properties = obj->properties();
+    const auto resource = properties.get_allocator().resource();
+
+    if (!obj->find(k))
+    {
+      return obj;
+    }
+
+    object::container_type result(properties, resource);
+
+    result.erase(object::key_type(k.name(), resource));
+
+    return internal::make_node<object>(resource, std::move(result));
+  }
+
+  /**
+   * Returns copy of given array where element at given index has been
+   * replaced with given value, or nothing if the index is out of bounds. If
+   * the element already is exactly the same value, the array itself is
+   * returned. Takes time linear in the size of the array; use
+   * `persistent_array` for large arrays which are updated incrementally.
+   */
+  inline std::optional<array::ptr>
+  with(const array::ptr& arr, std::size_t index, const value& v)
+  {
+    const auto& elements = arr->elements();
+
+    if (index >= elements.size())
+    {
+      return std::nullopt;
+    }
+    else if (elements[index] == v)
+    {
+      return arr;
+    }
+
+    const auto resource = elements.get_allocator().resource();
+    array::container_type result(elements, resource);
+
+    result[index] = v;
+
+    return internal::make_node<array>(resource, std::move(result));
+  }
+
+  /**
+   * Returns copy of given array with given value appended to the end of it.
+   * Takes time linear in the size of the array.
+   */
+  inline array::ptr
+  push(const array::ptr& arr, const value& v)
+  {
+    const auto& elements = arr->elements();
+    const auto resource = elements.get_allocator().resource();
+    array::container_type result(resource);
+
+    result.reserve(elements.size() + 1);
+    result.assign(std::begin(elements), std::end(elements));
+    result.push_back(v);
+
+    return internal::make_node<array>(resource, std::move(result));
+  }
+
+  /**
+   * Returns new version of given persistent object where given property has
+   * given value. Takes logarithmic time.
+   */
+  inline persistent_object
+  with(const persistent_object& obj, const key& k, const value& v)
+  {
+    return obj.set(k, v);
+  }
+
+  /**
+   * Returns new version of given persistent object without given property.
+   * Takes logarithmic time.
+   */
+  inline persistent_object
+  without(const persistent_object& obj, const key& k)
+  {
+    return obj.erase(k);
+  }
+
+  /**
+   * Returns new version of given persistent array where element at given
+   * index has been replaced with given value, or nothing if the index is out
+   * of bounds. Takes logarithmic time.
+   */
+  inline std::optional<persistent_array>
+  with(const persistent_array& arr, std::size_t index, const value& v)
+  {
+    if (index >= arr.size())
+    {
+      return std::nullopt;
+    }
+
+    return arr.set(index, v);
+  }
+
+  /**
+   * Returns new version of given persistent array with given value appended
+   * to the end of it. Takes logarithmic time.
+   */
+  inline persistent_array
+  push(const persistent_array& arr, const value& v)
+  {
+    return arr.push_back(v);
+  }
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2024, Rauli Laine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace peelo::json
+{
+  namespace internal
+  {
+    /**
+     * Determines whether given code point is an Unicode scalar value, e.g. it
+     * is in the Unicode range and not a surrogate, which means that it can be
+     * encoded in UTF-8.
+     */
+    inline bool
+    is_unicode_scalar_value(char32_t c)
+    {
+      return c <= 0x10ffff && (c < 0xd800 || c > 0xdfff);
+    }
+
+    /**
+     * Encodes given Unicode scalar value into UTF-8 and stores the result into
+     * given buffer, which must have room for at least four bytes. Returns the
+     * number of bytes written.
+     */
+    inline std::size_t
+    encode_utf8(char32_t c, char* buffer)
+    {
+      if (c < 0x80)
+      {
+        buffer[0] = static_cast<char>(c);
+
+        return 1;
+      }
+      else if (c < 0x800)
+      {
+        buffer[0] = static_cast<char>(0xc0 | (c >> 6));
+        buffer[1] = static_cast<char>(0x80 | (c & 0x3f));
+
+        return 2;
+      }
+      else if (c < 0x10000)
+      {
+        buffer[0] = static_cast<char>(0xe0 | (c >> 12));
+        buffer[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        buffer[2] = static_cast<char>(0x80 | (c & 0x3f));
+
+        return 3;
+      }
+      buffer[0] = static_cast<char>(0xf0 | (c >> 18));
+      buffer[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+      buffer[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+      buffer[3] = static_cast<char>(0x80 | (c & 0x3f));
+
+      return 4;
+    }
+
+    /**
+     * Returns number of bytes which given code point takes when encoded in
+     * UTF-8. Code points which are not Unicode scalar values are encoded as
+     * replacement character, which takes three bytes.
+     */
+    inline std::size_t
+    utf8_length(char32_t c)
+    {
+      if (c < 0x80)
+      {
+        return 1;
+      }
+      else if (c < 0x800)
+      {
+        return 2;
+      }
+      else if (c < 0x10000 || !is_unicode_scalar_value(c))
+      {
+        return 3;
+      }
+
+      return 4;
+    }
+
+    /**
+     * Decodes single code point from given UTF-8 encoded bytes. Returns the
+     * number of bytes the code point takes, or zero if the input does not
+     * begin with a valid UTF-8 sequence.
+     */
+    inline std::size_t
+    decode_utf8(const unsigned char* data, std::size_t size, char32_t& output)
+    {
+      const auto byte = data[0];
+      std::size_t length;
+      char32_t c;
+      char32_t min;
+
+      if (byte < 0x80)
+      {
+        output = byte;
+
+        return 1;
+      }
+      else if ((byte & 0xe0) == 0xc0)
+      {
+        length = 2;
+        c = byte & 0x1f;
+        min = 0x80;
+      }
+      else if ((byte & 0xf0) == 0xe0)
+      {
+        length = 3;
+        c = byte & 0x0f;
+        min = 0x800;
+      }
+      else if ((byte & 0xf8) == 0xf0)
+      {
+        length = 4;
+        c = byte & 0x07;
+        min = 0x10000;
+      } else {
+        return 0;
+      }
+      if (size < length)
+      {
+        return 0;
+      }
+      for (std::size_t i = 1; i < length; ++i)
+      {
+        if ((data[i] & 0xc0) != 0x80)
+        {
+          return 0;
+        }
+        c = (c << 6) | (data[i] & 0x3f);
+      }
+      if (c < min || !is_unicode_scalar_value(c))
+      {
+        return 0;
+      }
+      output = c;
+
+      return length;
+    }
+
+    /**
+     * Decodes given UTF-8 encoded bytes and appends the code points into
+     * given string. Returns false if the input is not valid UTF-8.
+     */
+    template<class String>
+    inline bool
+    decode_utf8(const unsigned char* data, std::size_t size, String& output)
+    {
+      std::size_t i = 0;
+
+      output.reserve(output.length() + size);
+      while (i < size)
+      {
+        char32_t c;
+        const auto length = decode_utf8(data + i, size - i, c);
+
+        if (!length)
+        {
+          return false;
+        }
+        output.push_back(c);
+        i += length;
+      }
+
+      return true;
+    }
+  }
+}
@@ -25,8 +25,19 @@
  */
 #pragma once
 
+#include <atomic>
+#include <charconv>
+#include <clocale>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
@@ -47,13 +58,210 @@ namespace peelo::json
 
   namespace internal
   {
+    class base;
+
+    inline void destroy_children(base&);
+
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+    /**
+     * Smart pointer to value node which keeps the reference count inside
+     * the node itself. The count is not atomic, so values must not be
+     * shared between threads in this mode.
+     */
+    template<class T>
+    class intrusive_ptr
+    {
+    public:
+      using element_type = T;
+
+      intrusive_ptr() noexcept
+        : m_pointer(nullptr) {}
+
+      intrusive_ptr(std::nullptr_t) noexcept
+        : m_pointer(nullptr) {}
+
+      explicit intrusive_ptr(T* pointer) noexcept
+        : m_pointer(pointer)
+      {
+        retain();
+      }
+
+      intrusive_ptr(const intrusive_ptr& that) noexcept
+        : m_pointer(that.m_pointer)
+      {
+        retain();
+      }
+
+      intrusive_ptr(intrusive_ptr&& that) noexcept
+        : m_pointer(that.detach()) {}
+
+      template<
+        class U,
+        class = std::enable_if_t<std::is_convertible_v<U*, T*>>
+      >
+      intrusive_ptr(const intrusive_ptr<U>& that) noexcept
+        : m_pointer(that.get())
+      {
+        retain();
+      }
+
+      template<
+        class U,
+        class = std::enable_if_t<std::is_convertible_v<U*, T*>>
+      >
+      intrusive_ptr(intrusive_ptr<U>&& that) noexcept
+        : m_pointer(that.detach()) {}
+
+      ~intrusive_ptr()
+      {
+        reset();
+      }
+
+      intrusive_ptr& operator=(intrusive_ptr that) noexcept
+      {
+        swap(that);
+
+        return *this;
+      }
+
+      inline T* get() const noexcept
+      {
+        return m_pointer;
+      }
+
+      inline T& operator*() const noexcept
+      {
+        return *m_pointer;
+      }
+
+      inline T* operator->() const noexcept
+      {
+        return m_pointer;
+      }
+
+      inline explicit operator bool() const noexcept
+      {
+        return m_pointer != nullptr;
+      }
+
+      /**
+       * Returns number of pointers referring to the node, or zero if this
+       * pointer is null.
+       */
+      inline long use_count() const noexcept
+      {
+        return m_pointer ? static_cast<long>(m_pointer->references()) : 0;
+      }
+
+      inline void reset() noexcept
+      {
+        if (const auto pointer = detach())
+        {
+          pointer->release();
+        }
+      }
+
+      inline void swap(intrusive_ptr& that) noexcept
+      {
+        std::swap(m_pointer, that.m_pointer);
+      }
+
+      /**
+       * Gives up ownership of the node without touching it's reference
+       * count, leaving this pointer null.
+       */
+      inline T* detach() noexcept
+      {
+        const auto pointer = m_pointer;
+
+        m_pointer = nullptr;
+
+        return pointer;
+      }
+
+    private:
+      inline void retain() const noexcept
+      {
+        if (m_pointer)
+        {
+          m_pointer->retain();
+        }
+      }
+
+    private:
+      T* m_pointer;
+    };
+
+    template<class T, class U>
+    inline bool
+    operator==(const intrusive_ptr<T>& a, const intrusive_ptr<U>& b) noexcept
+    {
+      return a.get() == b.get();
+    }
+
+    template<class T, class U>
+    inline bool
+    operator!=(const intrusive_ptr<T>& a, const intrusive_ptr<U>& b) noexcept
+    {
+      return a.get() != b.get();
+    }
+
+    template<class T>
+    inline bool
+    operator==(const intrusive_ptr<T>& a, std::nullptr_t) noexcept
+    {
+      return !a;
+    }
+
+    template<class T>
+    inline bool
+    operator==(std::nullptr_t, const intrusive_ptr<T>& a) noexcept
+    {
+      return !a;
+    }
+
+    template<class T>
+    inline bool
+    operator!=(const intrusive_ptr<T>& a, std::nullptr_t) noexcept
+    {
+      return static_cast<bool>(a);
+    }
+
+    template<class T>
+    inline bool
+    operator!=(std::nullptr_t, const intrusive_ptr<T>& a) noexcept
+    {
+      return static_cast<bool>(a);
+    }
+
+    /**
+     * Pointer type used for JSON values of given type.
+     */
+    template<class T>
+    using value_ptr = intrusive_ptr<T>;
+#else
+    /**
+     * Pointer type used for JSON values of given type.
+     */
+    template<class T>
+    using value_ptr = std::shared_ptr<T>;
+#endif
+
     /**
      * Abstract base class for all JSON values.
      */
     class base
     {
     public:
-      base() = default;
+      base()
+        : m_cached_hash(0)
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+        , m_references(0)
+        , m_resource(nullptr)
+        , m_destroy(nullptr)
+#endif
+        {}
+
       base(const base&) = delete;
       base(base&&) = delete;
       void operator=(const base&) = delete;
@@ -63,14 +271,175 @@ namespace peelo::json
        * Returns type of the value.
        */
       virtual enum type type() const = 0;
+
+      /**
+       * Returns previously computed structural hash of the value, or zero if
+       * it has not been computed yet. Since values are immutable, the hash
+       * never changes once computed.
+       */
+      inline std::size_t cached_hash() const
+      {
+        return m_cached_hash.load(std::memory_order_relaxed);
+      }
+
+      /**
+       * Stores structural hash of the value, so that it does not need to be
+       * computed again.
+       */
+      inline void cache_hash(std::size_t hash) const
+      {
+        m_cached_hash.store(hash, std::memory_order_relaxed);
+      }
+
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      /**
+       * Returns number of pointers referring to the value.
+       */
+      inline std::size_t references() const noexcept
+      {
+        return m_references;
+      }
+
+      inline void retain() const noexcept
+      {
+        ++m_references;
+      }
+
+      /**
+       * Decrements reference count of the value and destroys it, returning
+       * it's memory into the resource it was allocated from, once nothing
+       * refers to it anymore.
+       */
+      inline void release() const noexcept
+      {
+        if (!--m_references)
+        {
+          m_destroy(const_cast<base*>(this));
+        }
+      }
+
+      /**
+       * Records memory resource the value was allocated from and function
+       * used to destroy it. Called by `make_node()`.
+       */
+      inline void attach(
+        std::pmr::memory_resource* resource,
+        void (*destroy)(base*)
+      ) noexcept
+      {
+        m_resource = resource;
+        m_destroy = destroy;
+      }
+
+      inline std::pmr::memory_resource* resource() const noexcept
+      {
+        return m_resource;
+      }
+#endif
+
+    protected:
+      /**
+       * Moves child arrays and objects of the value into given stack, so
+       * that they can be destroyed without recursion. Only called when the
+       * value is being destroyed.
+       */
+      virtual void detach_children(std::vector<value_ptr<base>>&) {}
+
+      friend void destroy_children(base&);
+
+    private:
+      mutable std::atomic<std::size_t> m_cached_hash;
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      mutable std::size_t m_references;
+      std::pmr::memory_resource* m_resource;
+      void (*m_destroy)(base*);
+#endif
     };
+
+    inline bool
+    is_container(const value_ptr<base>& v)
+    {
+      return v && (v->type() == type::array || v->type() == type::object);
+    }
+
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+    /**
+     * Destroys value node of given type and returns it's memory into the
+     * resource it was allocated from.
+     */
+    template<class T>
+    void
+    destroy_node(base* node)
+    {
+      const auto resource = node->resource();
+      const auto pointer = static_cast<T*>(node);
+
+      pointer->~T();
+      std::pmr::polymorphic_allocator<T>(resource).deallocate(pointer, 1);
+    }
+#endif
+
+    /**
+     * Allocates value node of given type from given memory resource. Both
+     * the node and it's reference count are allocated from the resource, so
+     * the resource must outlive the node.
+     */
+    template<class T, class... Args>
+    inline auto
+    make_node(std::pmr::memory_resource* resource, Args&&... args)
+    {
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      if constexpr (std::is_base_of_v<base, T>)
+      {
+        std::pmr::polymorphic_allocator<T> allocator(resource);
+        const auto pointer = allocator.allocate(1);
+
+        try
+        {
+          ::new (static_cast<void*>(pointer)) T(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+          allocator.deallocate(pointer, 1);
+          throw;
+        }
+        pointer->attach(resource, &destroy_node<T>);
+
+        return intrusive_ptr<T>(pointer);
+      } else {
+#endif
+        return std::allocate_shared<T>(
+          std::pmr::polymorphic_allocator<T>(resource),
+          std::forward<Args>(args)...
+        );
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      }
+#endif
+    }
+
+    /**
+     * Casts value into pointer of given type without type checking.
+     */
+    template<class T>
+    inline value_ptr<T>
+    node_cast(const value_ptr<base>& v)
+    {
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+      return value_ptr<T>(static_cast<T*>(v.get()));
+#else
+      return std::static_pointer_cast<T>(v);
+#endif
+    }
   }
 
   /**
    * Representation of JSON value. If the pointer is `null`, then it represents
-   * null value.
+   * null value. By default this is `std::shared_ptr`. When the library is
+   * compiled with `PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT` defined, it's
+   * instead a pointer with non-atomic reference count stored in the value
+   * itself, which is cheaper to copy but must not be shared between threads.
    */
-  using value = std::shared_ptr<internal::base>;
+  using value = internal::value_ptr<internal::base>;
 
   /**
    * Representation of JSON array.
@@ -78,24 +447,50 @@ namespace peelo::json
   class array final : public internal::base
   {
   public:
-    using ptr = std::shared_ptr<array>;
+    using ptr = internal::value_ptr<array>;
     using value_type = value;
-    using container_type = std::vector<value_type>;
+    using container_type = std::pmr::vector<value_type>;
 
     array(const container_type& elements = container_type())
       : m_elements(elements) {}
 
+    array(container_type&& elements)
+      : m_elements(std::move(elements)) {}
+
+    array(
+      const container_type& elements,
+      std::pmr::memory_resource* resource
+    )
+      : m_elements(elements, resource) {}
+
     array(std::initializer_list<value_type> init)
       : m_elements(init) {}
 
-    static inline ptr make(const container_type& elements)
+    array(
+      std::initializer_list<value_type> init,
+      std::pmr::memory_resource* resource
+    )
+      : m_elements(init, resource) {}
+
+    ~array()
+    {
+      internal::destroy_children(*this);
+    }
+
+    static inline ptr make(
+      const container_type& elements,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
     {
-      return std::make_shared<array>(elements);
+      return internal::make_node<array>(resource, elements, resource);
     }
 
-    static inline ptr make(std::initializer_list<value_type> init)
+    static inline ptr make(
+      std::initializer_list<value_type> init,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
     {
-      return std::make_shared<array>(init);
+      return internal::make_node<array>(resource, init, resource);
     }
 
     inline enum type type() const
@@ -108,8 +503,20 @@ namespace peelo::json
       return m_elements;
     }
 
+  protected:
+    void detach_children(std::vector<value>& stack) override
+    {
+      for (auto& element : m_elements)
+      {
+        if (internal::is_container(element))
+        {
+          stack.push_back(std::move(element));
+        }
+      }
+    }
+
   private:
-    const container_type m_elements;
+    container_type m_elements;
   };
 
   /**
@@ -118,15 +525,18 @@ namespace peelo::json
   class boolean final : public internal::base
   {
   public:
-    using ptr = std::shared_ptr<boolean>;
+    using ptr = internal::value_ptr<boolean>;
     using value_type = bool;
 
     boolean(value_type value = false)
       : m_value(value) {}
 
-    static inline ptr make(value_type value)
+    static inline ptr make(
+      value_type value,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
     {
-      return std::make_shared<boolean>(value);
+      return internal::make_node<boolean>(resource, value);
     }
 
     inline enum type type() const
@@ -143,21 +553,145 @@ namespace peelo::json
     const value_type m_value;
   };
 
+  namespace internal
+  {
+    /**
+     * Converts decimal number in JSON syntax into double, independent of
+     * current locale. Numbers too large to be represented become infinity
+     * and numbers too small become zero or subnormal. Returns false if the
+     * whole input is not a number.
+     */
+    inline bool
+    parse_double(const char* first, const char* last, double& result)
+    {
+#if defined(__cpp_lib_to_chars)
+      const auto status = std::from_chars(first, last, result);
+
+      // Value is left unmodified when it's out of range, so those are
+      // converted with strtod() instead.
+      if (status.ec != std::errc::result_out_of_range)
+      {
+        return status.ec == std::errc() && status.ptr == last;
+      }
+#endif
+      // strtod() expects decimal point of current locale.
+      const auto point = std::localeconv()->decimal_point;
+      std::string buffer;
+      char* end;
+
+      buffer.reserve(static_cast<std::size_t>(last - first));
+      for (auto c = first; c < last; ++c)
+      {
+        if (*c == '.' && point && *point)
+        {
+          buffer.append(point);
+        } else {
+          buffer.append(1, *c);
+        }
+      }
+      result = std::strtod(buffer.c_str(), &end);
+
+      return !buffer.empty() && end == buffer.c_str() + buffer.length();
+    }
+  }
+
   /**
-   * Representation of JSON number.
+   * Representation of JSON number. Integers which fit in 64 bits are stored
+   * exactly, while other numbers are stored either as a double or as their
+   * original decimal digits, which are converted into double only when the
+   * value is actually needed.
    */
   class number final : public internal::base
   {
   public:
-    using ptr = std::shared_ptr<number>;
+    using ptr = internal::value_ptr<number>;
     using value_type = double;
 
+    /**
+     * Enumeration of different ways a number can be stored.
+     */
+    enum class kind
+    {
+      floating,
+      int64,
+      uint64,
+      digits,
+    };
+
     number(value_type value = 0.0)
-      : m_value(value) {}
+      : m_kind(kind::floating)
+      , m_double(value) {}
 
-    static inline ptr make(value_type value)
+    template<
+      class T,
+      std::enable_if_t<
+        std::is_integral_v<T> && !std::is_same_v<T, bool>,
+        int
+      > = 0
+    >
+    number(T value)
     {
-      return std::make_shared<number>(value);
+      if constexpr (std::is_signed_v<T>)
+      {
+        m_kind = kind::int64;
+        m_int64 = value;
+      }
+      else if (
+        value <= static_cast<T>(std::numeric_limits<std::int64_t>::max())
+      )
+      {
+        m_kind = kind::int64;
+        m_int64 = static_cast<std::int64_t>(value);
+      } else {
+        m_kind = kind::uint64;
+        m_uint64 = value;
+      }
+    }
+
+    /**
+     * Constructs number from decimal digits, which must be a valid JSON
+     * number.
+     */
+    number(std::string_view digits, std::pmr::memory_resource* resource)
+      : m_kind(kind::digits)
+      , m_double(0.0)
+      , m_digits(digits, resource)
+      , m_converted(std::numeric_limits<double>::quiet_NaN()) {}
+
+    static inline ptr make(
+      value_type value,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+    {
+      return internal::make_node<number>(resource, value);
+    }
+
+    template<
+      class T,
+      std::enable_if_t<
+        std::is_integral_v<T> && !std::is_same_v<T, bool>,
+        int
+      > = 0
+    >
+    static inline ptr make(
+      T value,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+    {
+      return internal::make_node<number>(resource, value);
+    }
+
+    /**
+     * Constructs number from decimal digits, which must be a valid JSON
+     * number. The digits are converted into double only when `value()` is
+     * called.
+     */
+    static inline ptr make_digits(
+      std::string_view digits,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+    {
+      return internal::make_node<number>(resource, digits, resource);
     }
 
     inline enum type type() const
@@ -165,41 +699,305 @@ namespace peelo::json
       return type::number;
     }
 
+    /**
+     * Returns the way the number is stored.
+     */
+    inline enum kind kind() const
+    {
+      return m_kind;
+    }
+
+    /**
+     * Returns the number as double, converting it from decimal digits on
+     * first call if needed.
+     */
     inline value_type value() const
     {
-      return m_value;
+      switch (m_kind)
+      {
+        case kind::int64:
+          return static_cast<value_type>(m_int64);
+
+        case kind::uint64:
+          return static_cast<value_type>(m_uint64);
+
+        case kind::digits:
+          {
+            auto result = m_converted.load(std::memory_order_relaxed);
+
+            // Valid JSON number is never NaN, so it's used for marking that
+            // the digits have not been converted yet.
+            if (std::isnan(result))
+            {
+              internal::parse_double(
+                m_digits.data(),
+                m_digits.data() + m_digits.length(),
+                result
+              );
+              m_converted.store(result, std::memory_order_relaxed);
+            }
+
+            return result;
+          }
+
+        default:
+          return m_double;
+      }
+    }
+
+    /**
+     * Returns the number as 64-bit signed integer, if it's a whole number
+     * within range of one.
+     */
+    inline std::optional<std::int64_t> as_int64() const
+    {
+      if (m_kind == kind::int64)
+      {
+        return m_int64;
+      }
+      else if (m_kind == kind::uint64)
+      {
+        return std::nullopt;
+      }
+
+      const auto result = value();
+
+      if (
+        std::trunc(result) == result &&
+        result >= -9223372036854775808.0 &&
+        result < 9223372036854775808.0
+      )
+      {
+        return static_cast<std::int64_t>(result);
+      }
+
+      return std::nullopt;
+    }
+
+    /**
+     * Returns the number as 64-bit unsigned integer, if it's a whole number
+     * within range of one.
+     */
+    inline std::optional<std::uint64_t> as_uint64() const
+    {
+      if (m_kind == kind::int64)
+      {
+        if (m_int64 >= 0)
+        {
+          return static_cast<std::uint64_t>(m_int64);
+        }
+
+        return std::nullopt;
+      }
+      else if (m_kind == kind::uint64)
+      {
+        return m_uint64;
+      }
+
+      const auto result = value();
+
+      if (
+        std::trunc(result) == result &&
+        result >= 0.0 &&
+        result < 18446744073709551616.0
+      )
+      {
+        return static_cast<std::uint64_t>(result);
+      }
+
+      return std::nullopt;
+    }
+
+    /**
+     * Returns the original decimal digits of the number, or empty string if
+     * the number is not stored as decimal digits.
+     */
+    inline std::string_view digits() const
+    {
+      return m_digits;
     }
 
   private:
-    const value_type m_value;
+    enum kind m_kind;
+    union
+    {
+      value_type m_double;
+      std::int64_t m_int64;
+      std::uint64_t m_uint64;
+    };
+    const std::pmr::string m_digits;
+    mutable std::atomic<value_type> m_converted;
+  };
+
+  namespace internal
+  {
+    /**
+     * FNV-1a hash of property name, which can be computed at compile time.
+     */
+    constexpr std::size_t
+    hash_key(std::u32string_view name)
+    {
+      std::uint64_t result = 0xcbf29ce484222325ULL;
+
+      for (const auto c : name)
+      {
+        result = (result ^ static_cast<std::uint64_t>(c)) * 0x100000001b3ULL;
+      }
+
+      return static_cast<std::size_t>(result);
+    }
+  }
+
+  /**
+   * Name of an object property with precomputed hash. Keys constructed from
+   * string literals have their hash computed at compile time, so looking up
+   * properties with them does not need to hash the name again.
+   *
+   * The key refers to the name without copying it, so the name must outlive
+   * the key.
+   */
+  class key
+  {
+  public:
+    constexpr key(std::u32string_view name)
+      : m_name(name)
+      , m_hash(internal::hash_key(name)) {}
+
+    constexpr key(const char32_t* name)
+      : key(std::u32string_view(name)) {}
+
+    constexpr std::u32string_view name() const
+    {
+      return m_name;
+    }
+
+    constexpr std::size_t hash() const
+    {
+      return m_hash;
+    }
+
+  private:
+    std::u32string_view m_name;
+    std::size_t m_hash;
   };
 
+  namespace internal
+  {
+    /**
+     * Accepts anything convertible into string view as a property name,
+     * which makes it the best match for string literals and pointers
+     * instead of them being ambiguous between string view and key.
+     */
+    template<class T>
+    using enable_if_name = std::enable_if_t<
+      std::is_convertible_v<const T&, std::u32string_view>,
+      int
+    >;
+
+    /**
+     * Hash function for property names, which also accepts string views and
+     * prehashed keys for heterogeneous lookup.
+     */
+    struct key_hash
+    {
+      using is_transparent = void;
+
+      template<class T, enable_if_name<T> = 0>
+      inline std::size_t operator()(const T& name) const
+      {
+        return hash_key(name);
+      }
+
+      inline std::size_t operator()(const key& k) const
+      {
+        return k.hash();
+      }
+    };
+
+    /**
+     * Equality comparison for property names, which also accepts string
+     * views and prehashed keys for heterogeneous lookup.
+     */
+    struct key_equal
+    {
+      using is_transparent = void;
+
+      template<class T, enable_if_name<T> = 0>
+      static inline std::u32string_view name(const T& name)
+      {
+        return name;
+      }
+
+      static inline std::u32string_view name(const key& k)
+      {
+        return k.name();
+      }
+
+      template<class A, class B>
+      inline bool operator()(const A& a, const B& b) const
+      {
+        return name(a) == name(b);
+      }
+    };
+  }
+
   /**
    * Representation of JSON object.
    */
   class object final : public internal::base
   {
   public:
-    using ptr = std::shared_ptr<object>;
-    using key_type = std::u32string;
+    using ptr = internal::value_ptr<object>;
+    using key_type = std::pmr::u32string;
     using mapped_type = value;
-    using container_type = std::unordered_map<key_type, mapped_type>;
+    using container_type = std::pmr::unordered_map<
+      key_type,
+      mapped_type,
+      internal::key_hash,
+      internal::key_equal
+    >;
     using value_type = container_type::value_type;
 
     object(const container_type& properties = container_type())
       : m_properties(properties) {}
 
+    object(container_type&& properties)
+      : m_properties(std::move(properties)) {}
+
+    object(
+      const container_type& properties,
+      std::pmr::memory_resource* resource
+    )
+      : m_properties(properties, resource) {}
+
     object(std::initializer_list<value_type> init)
       : m_properties(init) {}
 
-    static inline ptr make(const container_type& properties)
+    object(
+      std::initializer_list<value_type> init,
+      std::pmr::memory_resource* resource
+    )
+      : m_properties(init, 0, resource) {}
+
+    ~object()
     {
-      return std::make_shared<object>(properties);
+      internal::destroy_children(*this);
     }
 
-    static inline ptr make(std::initializer_list<value_type> init)
+    static inline ptr make(
+      const container_type& properties,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
     {
-      return std::make_shared<object>(init);
+      return internal::make_node<object>(resource, properties, resource);
+    }
+
+    static inline ptr make(
+      std::initializer_list<value_type> init,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
+    {
+      return internal::make_node<object>(resource, init, resource);
     }
 
     inline enum type type() const
@@ -212,8 +1010,76 @@ namespace peelo::json
       return m_properties;
     }
 
+    /**
+     * Looks up property with given name, without allocating memory.
+     * Returns pointer to value of the property, or null pointer if the
+     * object has no such property.
+     */
+    inline const value* find(const key& k) const
+    {
+#if defined(__cpp_lib_generic_unordered_lookup)
+      const auto it = m_properties.find(k);
+
+      return it != std::end(m_properties) ? &it->second : nullptr;
+#elif defined(__GLIBCXX__) || defined(_LIBCPP_VERSION) || defined(_MSC_VER)
+      // Heterogeneous lookup is not available before C++20, so the bucket
+      // is located from the precomputed hash instead. All of these standard
+      // libraries map hash into bucket with modulo of the bucket count.
+      const auto count = m_properties.bucket_count();
+
+      if (count == 0)
+      {
+        return nullptr;
+      }
+
+      const auto n = k.hash() % count;
+      const auto end = m_properties.end(n);
+
+      for (auto it = m_properties.begin(n); it != end; ++it)
+      {
+        if (it->first == k.name())
+        {
+          return &it->second;
+        }
+      }
+
+      return nullptr;
+#else
+      // Bucket of a hash is unspecified, so the name is copied into a
+      // temporary key in a stack buffer instead.
+      char32_t buffer[64];
+      std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer));
+      const auto it = m_properties.find(key_type(k.name(), &resource));
+
+      return it != std::end(m_properties) ? &it->second : nullptr;
+#endif
+    }
+
+    /**
+     * Returns value of property with given name, or null if the object has
+     * no such property.
+     */
+    inline value get(const key& k) const
+    {
+      const auto result = find(k);
+
+      return result ? *result : nullptr;
+    }
+
+  protected:
+    void detach_children(std::vector<value>& stack) override
+    {
+      for (auto& property : m_properties)
+      {
+        if (internal::is_container(property.second))
+        {
+          stack.push_back(std::move(property.second));
+        }
+      }
+    }
+
   private:
-    const container_type m_properties;
+    container_type m_properties;
   };
 
   /**
@@ -222,15 +1088,24 @@ namespace peelo::json
   class string final : public internal::base
   {
   public:
-    using ptr = std::shared_ptr<string>;
-    using value_type = std::u32string;
+    using ptr = internal::value_ptr<string>;
+    using value_type = std::pmr::u32string;
 
     string(const value_type& value = value_type())
       : m_value(value) {}
 
-    static inline ptr make(const value_type& value)
+    string(value_type&& value)
+      : m_value(std::move(value)) {}
+
+    string(std::u32string_view value, std::pmr::memory_resource* resource)
+      : m_value(value, resource) {}
+
+    static inline ptr make(
+      std::u32string_view value,
+      std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    )
     {
-      return std::make_shared<string>(value);
+      return internal::make_node<string>(resource, value, resource);
     }
 
     inline enum type type() const
@@ -247,6 +1122,33 @@ namespace peelo::json
     const value_type m_value;
   };
 
+  namespace internal
+  {
+    /**
+     * Destroys child arrays and objects of given value without recursion.
+     * Children which are not referenced from anywhere else have their own
+     * children detached before they are destroyed, so destroying a deeply
+     * nested tree does not overflow the call stack.
+     */
+    inline void
+    destroy_children(base& node)
+    {
+      std::vector<value> stack;
+
+      node.detach_children(stack);
+      while (!stack.empty())
+      {
+        const auto v = std::move(stack.back());
+
+        stack.pop_back();
+        if (v.use_count() == 1)
+        {
+          v->detach_children(stack);
+        }
+      }
+    }
+  }
+
   /**
    * Returns type of given value.
    */
@@ -262,9 +1164,22 @@ namespace peelo::json
    * function.
    */
   template<class T>
-  inline std::shared_ptr<T>
+  inline typename T::ptr
   as(const value& v)
   {
-    return std::static_pointer_cast<T>(v);
+    return internal::node_cast<T>(v);
+  }
+
+  /**
+   * Like `as` but returns reference to the value instead of a new shared
+   * pointer, so the reference count is not touched at all. The reference is
+   * valid as long as the value is. No type checking is done, and the value
+   * must not be null.
+   */
+  template<class T>
+  inline const T&
+  as_ref(const value& v)
+  {
+    return static_cast<const T&>(*v);
   }
 }
@@ -51,8 +51,15 @@ namespace peelo::json
     visit_string(const string::value_type& value) = 0;
   };
 
+  /**
+   * Statically dispatched version of `accept()`. Methods of the visitor are
+   * called directly instead of through virtual functions, so they can be
+   * inlined. The visitor does not need to inherit from `visitor` class, any
+   * type which has the same `visit_*` methods can be used.
+   */
+  template<class Visitor>
   inline void
-  accept(class visitor& visitor, const value& v)
+  accept(Visitor& visitor, const value& v)
   {
     switch (type_of(v))
     {
@@ -81,4 +88,10 @@ namespace peelo::json
         break;
     }
   }
+
+  inline void
+  accept(class visitor& visitor, const value& v)
+  {
+    accept<class visitor>(visitor, v);
+  }
 }
@@ -0,0 +1,126 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/cbor.hpp>
+#include <peelo/json/hash.hpp>
+#include <peelo/json/parser.hpp>
+
+using namespace peelo::json;
+
+using bytes = std::vector<std::uint8_t>;
+
+TEST_CASE("Scalars are encoded in CBOR", "[cbor]")
+{
+  REQUIRE(encode_cbor(nullptr) == bytes{ 0xf6 });
+  REQUIRE(encode_cbor(boolean::make(true)) == bytes{ 0xf5 });
+  REQUIRE(encode_cbor(number::make(23)) == bytes{ 0x17 });
+  REQUIRE(encode_cbor(number::make(24)) == bytes{ 0x18, 0x18 });
+  REQUIRE(encode_cbor(number::make(-1)) == bytes{ 0x20 });
+  REQUIRE(encode_cbor(number::make(1000.0)) == bytes{ 0x19, 0x03, 0xe8 });
+  REQUIRE(
+    encode_cbor(number::make(1.5)) ==
+    bytes{ 0xfb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0 }
+  );
+  REQUIRE(
+    encode_cbor(string::make(U"ü")) ==
+    bytes{ 0x62, 0xc3, 0xbc }
+  );
+}
+
+TEST_CASE("Containers are encoded in CBOR", "[cbor]")
+{
+  REQUIRE(
+    encode_cbor(array::make({
+      number::make(1),
+      array::make({ number::make(2), number::make(3) }),
+    })) == bytes{ 0x82, 0x01, 0x82, 0x02, 0x03 }
+  );
+  REQUIRE(
+    encode_cbor(object::make({ { U"a", number::make(1) } })) ==
+    bytes{ 0xa1, 0x61, 0x61, 0x01 }
+  );
+}
+
+TEST_CASE("Values survive CBOR round trip", "[cbor]")
+{
+  const auto document = parse(
+    U"{\"a\": [1, -2, 3.25, 18446744073709551615, -9223372036854775808],"
+    U"\"b\": {\"c\": null, \"d\": true, \"e\": \"ä\U0001f600\"}}"
+  );
+
+  REQUIRE(document.has_value());
+
+  const auto result = decode_cbor(encode_cbor(*document));
+
+  REQUIRE(result.has_value());
+  REQUIRE(equals(*result, *document));
+}
+
+TEST_CASE("CBOR extensions are decoded", "[cbor]")
+{
+  const auto half = decode_cbor(bytes{ 0xf9, 0x3c, 0x00 });
+  const auto indefinite = decode_cbor(
+    bytes{ 0x9f, 0x01, 0x7f, 0x61, 0x61, 0x61, 0x62, 0xff, 0xff }
+  );
+  const auto tagged = decode_cbor(bytes{ 0xc1, 0x1a, 0, 0, 0, 1 });
+
+  REQUIRE(half.has_value());
+  REQUIRE(as<number>(*half)->value() == 1.0);
+  REQUIRE(indefinite.has_value());
+  REQUIRE(as<array>(*indefinite)->elements().size() == 2);
+  REQUIRE(
+    as<string>(as<array>(*indefinite)->elements()[1])->value() == U"ab"
+  );
+  REQUIRE(tagged.has_value());
+  REQUIRE(*as<number>(*tagged)->as_int64() == 1);
+}
+
+TEST_CASE("Malformed CBOR produces error", "[cbor]")
+{
+  REQUIRE(!decode_cbor(bytes{ 0x82, 0x01 }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0x62, 0xc3 }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0x61, 0xff }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0xa1, 0x01, 0x01 }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0x41, 0x00 }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0x01, 0x01 }).has_value());
+  REQUIRE(decode_cbor(bytes{ 0x01, 0x01 }).error().position().offset == 1);
+  REQUIRE(!decode_cbor(bytes(9, 0xff)).has_value());
+  REQUIRE(!decode_cbor(
+    bytes{ 0x9b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }
+  ).has_value());
+}
+
+TEST_CASE("CBOR indefinite length is only accepted for containers", "[cbor]")
+{
+  REQUIRE(!decode_cbor(bytes{ 0x1f }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0x3f }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0xdf, 0x01 }).has_value());
+  REQUIRE(!decode_cbor(bytes{ 0xff }).has_value());
+  REQUIRE(decode_cbor(bytes{ 0xbf, 0xff }).has_value());
+}
+
+TEST_CASE("Deeply nested CBOR produces error", "[cbor]")
+{
+  auto nested = bytes(512, 0x81);
+
+  nested.push_back(0x80);
+  REQUIRE(decode_cbor(nested).has_value());
+
+  bytes maps;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    maps.insert(std::end(maps), { 0xa1, 0x61, 0x61 });
+  }
+
+  const auto arrays = bytes(1000000, 0x81);
+  const auto tags = bytes(1000000, 0xc6);
+
+  for (const auto& input : { arrays, tags, maps })
+  {
+    const auto result = decode_cbor(input);
+
+    REQUIRE(!result.has_value());
+    REQUIRE(
+      std::string(result.error().what()) == "Maximum nesting depth exceeded."
+    );
+  }
+}
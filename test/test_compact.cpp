@@ -0,0 +1,130 @@
+#include <limits>
+
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/compact.hpp>
+
+using namespace peelo::json;
+
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment)
+  {
+    ++allocations;
+
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+  {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& that) const noexcept
+  {
+    return this == &that;
+  }
+};
+
+TEST_CASE("Scalars are stored inside compact value", "[compact]")
+{
+  const compact_value null;
+  const compact_value boolean(true);
+  const compact_value number(1.5);
+  const compact_value short_string(U"abc");
+
+  REQUIRE(sizeof(compact_value) == 16);
+  REQUIRE(type_of(null) == type::null);
+  REQUIRE(type_of(boolean) == type::boolean);
+  REQUIRE(boolean.as_boolean());
+  REQUIRE(type_of(number) == type::number);
+  REQUIRE(number.as_number() == 1.5);
+  REQUIRE(type_of(short_string) == type::string);
+  REQUIRE(short_string.as_string() == U"abc");
+  REQUIRE(null.is_inline());
+  REQUIRE(boolean.is_inline());
+  REQUIRE(number.is_inline());
+  REQUIRE(short_string.is_inline());
+}
+
+TEST_CASE("Containers and long strings are shared", "[compact]")
+{
+  const auto arr = array::make({ number::make(1) });
+  const compact_value a(arr);
+  const compact_value b(a);
+  const compact_value long_string(U"long string");
+  compact_value c(long_string);
+
+  REQUIRE(!a.is_inline());
+  REQUIRE(type_of(b) == type::array);
+  REQUIRE(as<array>(b) == arr);
+  REQUIRE(!long_string.is_inline());
+  REQUIRE(c.as_string() == U"long string");
+
+  c = compact_value(2.0);
+  REQUIRE(c.as_number() == 2.0);
+  REQUIRE(long_string.as_string() == U"long string");
+}
+
+TEST_CASE("Compact values are converted to values", "[compact]")
+{
+  const compact_value boolean(boolean::make(false));
+  const compact_value number(number::make(3.0));
+  const compact_value string(string::make(U"ab"));
+
+  REQUIRE(type_of(boolean.to_value()) == type::boolean);
+  REQUIRE(!as<peelo::json::boolean>(boolean)->value());
+  REQUIRE(as<peelo::json::number>(number)->value() == 3.0);
+  REQUIRE(string.is_inline());
+  REQUIRE(as<peelo::json::string>(string)->value() == U"ab");
+  REQUIRE(compact_value(value()).to_value() == nullptr);
+}
+
+TEST_CASE("Integers are stored exactly in compact value", "[compact]")
+{
+  const std::int64_t large = 9007199254740993;
+  const compact_value signed_number(number::make(large));
+  const compact_value unsigned_number(
+    std::numeric_limits<std::uint64_t>::max()
+  );
+
+  REQUIRE(signed_number.is_inline());
+  REQUIRE(signed_number.number_kind() == number::kind::int64);
+  REQUIRE(*signed_number.as_int64() == large);
+  REQUIRE(*as<number>(signed_number)->as_int64() == large);
+  REQUIRE(unsigned_number.number_kind() == number::kind::uint64);
+  REQUIRE(!unsigned_number.as_int64());
+  REQUIRE(
+    *as<number>(unsigned_number)->as_uint64() ==
+    std::numeric_limits<std::uint64_t>::max()
+  );
+  REQUIRE(compact_value(-3).as_number() == -3.0);
+}
+
+TEST_CASE("Shared storage uses memory resource of the value", "[compact]")
+{
+  counting_resource resource;
+
+  {
+    const auto arr = array::make({ number::make(1) }, &resource);
+    const auto allocations = resource.allocations;
+    const compact_value a(arr);
+    const compact_value b(a);
+    const compact_value long_string(U"long string", &resource);
+
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+    REQUIRE(resource.allocations == allocations + 2);
+#else
+    REQUIRE(resource.allocations == allocations + 4);
+#endif
+    REQUIRE(as<array>(b) == arr);
+    REQUIRE(long_string.as_string() == U"long string");
+  }
+
+  REQUIRE(resource.allocations == resource.deallocations);
+}
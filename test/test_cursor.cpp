@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/cursor.hpp>
+
+using namespace peelo::json;
+
+TEST_CASE("Values are visited in pre-order", "[cursor]")
+{
+  const auto root = array::make({
+    number::make(1),
+    array::make({ number::make(2), number::make(3) }),
+    object::make({ { U"a", number::make(4) } }),
+  });
+  cursor c(root);
+  std::vector<double> numbers;
+  std::vector<std::size_t> depths;
+
+  while (c.next())
+  {
+    depths.push_back(c.depth());
+    if (type_of(c.current()) == type::number)
+    {
+      numbers.push_back(as<number>(c.current())->value());
+    }
+  }
+
+  REQUIRE(numbers == std::vector<double>{ 1, 2, 3, 4 });
+  REQUIRE(depths == std::vector<std::size_t>{ 0, 1, 1, 2, 2, 1, 2 });
+  REQUIRE(!c.next());
+}
+
+TEST_CASE("Path of current value is reported", "[cursor]")
+{
+  const auto root = object::make({
+    { U"a", array::make({ nullptr, boolean::make(true) }) },
+  });
+  cursor c(root);
+
+  while (c.next() && type_of(c.current()) != type::boolean);
+
+  REQUIRE(c.depth() == 2);
+  REQUIRE(c.path()[0].parent == type::object);
+  REQUIRE(c.path()[0].key == U"a");
+  REQUIRE(c.path()[1].parent == type::array);
+  REQUIRE(c.path()[1].index == 1);
+}
+
+TEST_CASE("Children of value can be skipped", "[cursor]")
+{
+  const auto root = array::make({
+    array::make({ array::make({ number::make(1) }) }),
+    number::make(2),
+  });
+  cursor c(root);
+  std::size_t count = 0;
+
+  while (c.next())
+  {
+    ++count;
+    if (c.depth() == 1)
+    {
+      c.skip_children();
+    }
+  }
+
+  REQUIRE(count == 3);
+}
+
+TEST_CASE("Deeply nested values are traversed", "[cursor]")
+{
+  value root;
+
+  for (int i = 0; i < 100000; ++i)
+  {
+    root = array::make({ root });
+  }
+
+  cursor c(root);
+  std::size_t max_depth = 0;
+
+  while (c.next())
+  {
+    max_depth = c.depth();
+  }
+
+  REQUIRE(max_depth == 100000);
+}
@@ -0,0 +1,122 @@
+#include <sstream>
+
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/filter.hpp>
+
+using namespace peelo::json;
+
+static filter
+make_filter(filter_mode mode = filter_mode::any)
+{
+  return filter(
+    {
+      { { U"level" }, filter_operator::equal, string::make(U"error") },
+      {
+        { U"http", U"status" },
+        filter_operator::greater_equal,
+        number::make(500),
+      },
+    },
+    mode
+  );
+}
+
+TEST_CASE("Records are matched from raw bytes", "[filter]")
+{
+  const auto f = make_filter();
+
+  REQUIRE(f.matches(R"({"level": "error", "message": "failed"})"));
+  REQUIRE(f.matches(R"({"http": {"path": "/", "status": 503}})"));
+  REQUIRE(f.matches(R"({"x": [1, {"level": "info"}], "level":"error"})"));
+  REQUIRE(!f.matches(R"({"level": "info", "message": "error"})"));
+  REQUIRE(!f.matches(R"({"http": {"status": 404}, "level": "warning"})"));
+  REQUIRE(!f.matches(R"({"status": 500})"));
+  REQUIRE(!f.matches(R"({"level": ["error"]})"));
+  REQUIRE(!f.matches(R"([{"level": "error"}])"));
+  REQUIRE(!f.matches(""));
+}
+
+TEST_CASE("Escape sequences are decoded when matching", "[filter]")
+{
+  const auto f = make_filter();
+
+  REQUIRE(f.matches(R"({"lev\u0065l": "err\u006fr"})"));
+  REQUIRE(f.matches(R"({"a": "\"level\": \"error\"", "level": "error"})"));
+  REQUIRE(!f.matches(R"({"a": "\"level\": \"error\""})"));
+}
+
+TEST_CASE("All predicates must match in all mode", "[filter]")
+{
+  const auto f = make_filter(filter_mode::all);
+
+  REQUIRE(f.matches(R"({"level": "error", "http": {"status": 500}})"));
+  REQUIRE(!f.matches(R"({"level": "error", "http": {"status": 200}})"));
+  REQUIRE(!f.matches(R"({"level": "error"})"));
+}
+
+TEST_CASE("Booleans and null are compared for equality", "[filter]")
+{
+  const filter f(
+    {
+      { { U"ok" }, filter_operator::not_equal, boolean::make(true) },
+      { { U"user" }, filter_operator::equal, nullptr },
+    }
+  );
+
+  REQUIRE(f.matches(R"({"ok": false})"));
+  REQUIRE(f.matches(R"({"ok": true, "user": null})"));
+  REQUIRE(!f.matches(R"({"ok": true, "user": "a"})"));
+  REQUIRE(!f.matches(R"({"ok": 1})"));
+  REQUIRE(!f.matches(R"({"ok": null})"));
+  REQUIRE(!f.matches(R"({"ok": true, "user": false})"));
+}
+
+TEST_CASE("Last occurrence of duplicate property is used", "[filter]")
+{
+  const auto f = make_filter();
+
+  REQUIRE(!f.matches(R"({"level": "error", "level": "info"})"));
+  REQUIRE(f.matches(R"({"level": "info", "level": "error"})"));
+  REQUIRE(!f.matches(
+    R"({"http": {"status": 503, "status": 200}, "http": {"status": 404}})"
+  ));
+  REQUIRE(f.matches(R"({"http": {"status": 200}, "http": {"status": 5e2}})"));
+}
+
+TEST_CASE("Only matching lines are parsed", "[filter_lines]")
+{
+  std::string input;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    input.append(
+      "{\"level\": \"" + std::string(i % 100 ? "info" : "error") +
+      "\", \"index\": " + std::to_string(i) + "}\r\n"
+    );
+    if (i == 500)
+    {
+      input.append("\n{\"level\": \"error\", \"index\": 1x}\n");
+    }
+  }
+  input.append("{\"http\": {\"status\": 502}}");
+
+  std::istringstream stream(input);
+  istream_input in(stream);
+  std::vector<value> matches;
+  std::vector<int> errors;
+
+  REQUIRE(filter_lines(in, make_filter(), [&](parse_result&& result)
+  {
+    if (result)
+    {
+      matches.push_back(*result);
+    } else {
+      errors.push_back(result.error().position().line);
+    }
+  }));
+
+  REQUIRE(matches.size() == 11);
+  REQUIRE(as<number>(as<object>(matches[5])->get(U"index"))->value() == 500);
+  REQUIRE(type_of(as<object>(matches[10])->get(U"http")) == type::object);
+  REQUIRE(errors == std::vector<int>{ 503 });
+}
@@ -1,5 +1,10 @@
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
 #include <catch2/catch_test_macros.hpp>
 #include <peelo/json/formatter.hpp>
+#include <peelo/json/parser.hpp>
 
 using namespace peelo::json;
 
@@ -7,9 +12,9 @@ TEST_CASE("Array is formatted", "[format]")
 {
   REQUIRE(
     !format(array::make({
-      std::make_shared<number>(1),
-      std::make_shared<number>(2),
-      std::make_shared<number>(3),
+      number::make(1),
+      number::make(2),
+      number::make(3),
     })).compare("[1,2,3]")
   );
 }
@@ -32,6 +37,25 @@ TEST_CASE("Number if formatted", "[format]")
   REQUIRE(!format(number::make(-500)).compare("-500"));
 }
 
+TEST_CASE("Number is formatted without losing precision", "[format]")
+{
+  REQUIRE(!format(number::make(1234567)).compare("1234567"));
+  REQUIRE(
+    !format(number::make(9007199254740991.0)).compare("9007199254740991")
+  );
+  REQUIRE(!format(number::make(0.1)).compare("0.1"));
+  REQUIRE(!format(number::make(60.1699121)).compare("60.1699121"));
+  REQUIRE(!format(number::make(-24.9384013)).compare("-24.9384013"));
+  REQUIRE(!format(number::make(1e300)).compare("1e+300"));
+  REQUIRE(!format(number::make(-0.0)).compare("-0"));
+}
+
+TEST_CASE("Non-finite number is formatted as null", "[format]")
+{
+  REQUIRE(!format(number::make(HUGE_VAL)).compare("null"));
+  REQUIRE(!format(number::make(std::nan(""))).compare("null"));
+}
+
 TEST_CASE("Object is formatted", "[format]")
 {
   REQUIRE(
@@ -54,3 +78,378 @@ TEST_CASE("String is formatted", "[format]")
   REQUIRE(!format(string::make(U"/")).compare("\"\\/\""));
   REQUIRE(!format(string::make(U"\u00e4")).compare("\"\\u00e4\""));
 }
+
+TEST_CASE("Astral plane characters are escaped as surrogate pairs", "[format]")
+{
+  REQUIRE(!format(string::make(U"\U0001f600")).compare("\"\\ud83d\\ude00\""));
+  REQUIRE(!format(string::make(U"\u20ac")).compare("\"\\u20ac\""));
+}
+
+TEST_CASE("String is formatted as UTF-8", "[format]")
+{
+  format_options options;
+
+  options.encoding = format_encoding::utf8;
+
+  REQUIRE(
+    !format(string::make(U"\u00e4\u20ac\U0001f600/"), options)
+      .compare("\"\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\x80/\"")
+  );
+  REQUIRE(
+    !format(string::make(U"\"\\\n\x01"), options)
+      .compare("\"\\\"\\\\\\n\\u0001\"")
+  );
+  REQUIRE(
+    !format(string::make(std::u32string(1, 0xd800)), options)
+      .compare("\"\\ud800\"")
+  );
+}
+
+TEST_CASE("Value is formatted into stream sink", "[format_to]")
+{
+  std::ostringstream stream;
+  ostream_sink sink(stream);
+
+  format_to(sink, array::make({ boolean::make(true), nullptr }));
+
+  REQUIRE(!stream.str().compare("[true,null]"));
+}
+
+TEST_CASE("Large value is formatted in chunks", "[format_to]")
+{
+  array::container_type elements;
+  std::string output;
+  int chunk_count = 0;
+
+  for (int i = 0; i < 5000; ++i)
+  {
+    elements.push_back(string::make(U"foo"));
+  }
+
+  const auto value = array::make(elements);
+  callback_sink sink([&](const char* data, std::size_t size)
+  {
+    REQUIRE(size <= 4096);
+    output.append(data, size);
+    ++chunk_count;
+  });
+
+  format_to(sink, value);
+
+  REQUIRE(chunk_count > 1);
+  REQUIRE(!output.compare(format(value)));
+}
+
+TEST_CASE("Value is formatted into fixed size buffer", "[format_to]")
+{
+  char buffer[8];
+  const auto value = array::make({ number::make(1), number::make(2) });
+
+  REQUIRE(format_to(buffer, sizeof(buffer), value) == 5);
+  REQUIRE(!std::string(buffer, 5).compare("[1,2]"));
+}
+
+TEST_CASE("Output is truncated to size of fixed size buffer", "[format_to]")
+{
+  char buffer[3];
+  const auto value = string::make(U"foobar");
+
+  REQUIRE(format_to(buffer, sizeof(buffer), value) == 8);
+  REQUIRE(!std::string(buffer, 3).compare("\"fo"));
+}
+
+TEST_CASE("Long string with escapes is formatted", "[format]")
+{
+  string::value_type input;
+  std::string expected("\"");
+
+  for (int i = 0; i < 100; ++i)
+  {
+    input.append(i, U'a');
+    expected.append(i, 'a');
+    if (i % 3)
+    {
+      input.append(1, U'\n');
+      expected.append("\\n");
+    } else {
+      input.append(1, U'"');
+      expected.append("\\\"");
+    }
+  }
+  expected.append(1, '"');
+
+  REQUIRE(!format(string::make(input)).compare(expected));
+}
+
+TEST_CASE("Size of formatted value is computed", "[formatted_size]")
+{
+  const auto value = object::make({
+    { U"a\u00e4", array::make({ number::make(1.5), boolean::make(false) }) },
+    { U"b\n", string::make(U"\U0001f600") },
+  });
+
+  format_options options;
+
+  options.encoding = format_encoding::utf8;
+
+  // {"a\u00e4":[1.5,false],"b\n":"\ud83d\ude00"}
+  REQUIRE(formatted_size(value) == 44);
+  // Same output, with the two characters encoded in UTF-8 instead.
+  REQUIRE(formatted_size(value, options) == 32);
+  REQUIRE(formatted_size(nullptr) == 4);
+  REQUIRE(formatted_size(string::make(U"\"\x01")) == 10);
+}
+
+TEST_CASE("Value is formatted into exactly sized buffer", "[formatted_size]")
+{
+  const auto value = array::make({ string::make(U"foo"), number::make(-2) });
+  const auto size = formatted_size(value);
+  std::string buffer(size, ' ');
+
+  REQUIRE(format_to(buffer.data(), buffer.size(), value) == size);
+  REQUIRE(!buffer.compare("[\"foo\",-2]"));
+}
+
+TEST_CASE("Object keys are sorted in canonical output", "[format]")
+{
+  format_options options;
+
+  options.sort_keys = true;
+
+  REQUIRE(
+    !format(object::make({
+      { U"b", number::make(1) },
+      { U"a", object::make({ { U"d", nullptr }, { U"c", nullptr } }) },
+      { U"\u00e4", number::make(2) },
+      { U"B", number::make(3) },
+    }), options).compare(
+      "{\"B\":3,\"a\":{\"c\":null,\"d\":null},\"b\":1,\"\\u00e4\":2}"
+    )
+  );
+}
+
+TEST_CASE("Formatted subtrees are cached", "[format_cache]")
+{
+  format_cache cache(format_options(), 1024, 8);
+  const auto shared = object::make({ { U"foo", string::make(U"bar") } });
+  const auto value = array::make({ shared, shared, number::make(1) });
+
+  REQUIRE(!format(value, cache).compare(format(value)));
+  REQUIRE(cache.find(shared));
+  REQUIRE(!cache.find(value));
+  REQUIRE(cache.count() == 1);
+  REQUIRE(!cache.find(shared)->compare("{\"foo\":\"bar\"}"));
+  REQUIRE(!format(value, cache).compare(format(value)));
+  REQUIRE(cache.count() == 1);
+}
+
+TEST_CASE("Values which are not shared are not cached", "[format_cache]")
+{
+  format_cache cache(format_options(), 1024, 0);
+  const auto inner = array::make({ number::make(1) });
+  const auto outer = array::make({ inner, array::make({ inner }) });
+  const auto root = array::make({ outer, outer });
+
+  array::container_type elements;
+
+  elements.push_back(array::make({ nullptr }));
+
+  const auto unshared = array::make(elements);
+
+  elements.clear();
+  REQUIRE(!format(unshared, cache).compare("[[null]]"));
+  REQUIRE(cache.count() == 0);
+
+  // Only the outermost shared value is cached, with the shared values nested
+  // inside it written into the same output.
+  REQUIRE(!format(root, cache).compare("[[[1],[[1]]],[[1],[[1]]]]"));
+  REQUIRE(cache.count() == 1);
+  REQUIRE(!cache.find(outer)->compare("[[1],[[1]]]"));
+  REQUIRE(!cache.find(inner));
+}
+
+TEST_CASE("Size of format cache is bounded", "[format_cache]")
+{
+  format_cache cache(format_options(), 32, 0);
+  const auto a = array::make({ string::make(U"0123456789") });
+  const auto b = array::make({ string::make(U"abcdefghij") });
+  const auto c = array::make({ string::make(U"ABCDEFGHIJ") });
+
+  cache.insert(a, format(a));
+  cache.insert(b, format(b));
+  cache.insert(c, format(c));
+
+  REQUIRE(cache.size() <= 32);
+  REQUIRE(!cache.find(a));
+  REQUIRE(cache.find(c));
+}
+
+TEST_CASE("Format cache can be precomputed", "[format_cache]")
+{
+  format_cache cache;
+  const auto value = array::make({ number::make(1) });
+
+  REQUIRE(!cache.find(value));
+  cache.precompute(value);
+  REQUIRE(cache.find(value));
+  REQUIRE(!cache.find(value)->compare("[1]"));
+}
+
+TEST_CASE("Expired values are purged from format cache", "[format_cache]")
+{
+  format_cache cache(format_options(), 1024, 0);
+  auto a = array::make({ number::make(1) });
+  const auto b = array::make({ number::make(2) });
+
+  cache.precompute(a);
+  cache.precompute(b);
+  REQUIRE(cache.count() == 2);
+
+  a = nullptr;
+  cache.purge();
+
+  REQUIRE(cache.count() == 1);
+  REQUIRE(cache.size() == 3);
+  REQUIRE(cache.find(b));
+}
+
+TEST_CASE("Unmodified values are copied from source code", "[format]")
+{
+  source_map sources;
+  parse_options parse_opts;
+  format_options format_opts;
+
+  parse_opts.sources = &sources;
+  format_opts.sources = &sources;
+
+  const auto result = parse(
+    U"{\"a\": [1.50, 2e3, \"\u00e4\"]}",
+    parse_opts
+  );
+
+  REQUIRE(result.has_value());
+  REQUIRE(!format(*result, format_opts).compare(
+    "{\"a\": [1.50, 2e3, \"\\u00e4\"]}"
+  ));
+
+  const auto edited = array::make({
+    as<object>(*result)->properties().at(U"a"),
+    number::make(1.5),
+  });
+
+  REQUIRE(!format(edited, format_opts).compare(
+    "[[1.50, 2e3, \"\\u00e4\"],1.5]"
+  ));
+
+  format_opts.encoding = format_encoding::utf8;
+  REQUIRE(!format(*result, format_opts).compare(
+    "{\"a\": [1.50, 2e3, \"\xc3\xa4\"]}"
+  ));
+
+  format_opts.sort_keys = true;
+  REQUIRE(!format(*result, format_opts).compare(
+    "{\"a\":[1.5,2000,\"\xc3\xa4\"]}"
+  ));
+}
+
+TEST_CASE("Values dropped by parser stay in source map", "[format]")
+{
+  source_map sources;
+  parse_options parse_opts;
+  format_options format_opts;
+
+  parse_opts.sources = &sources;
+  format_opts.sources = &sources;
+
+  const auto result = parse(U"{\"a\": [1, 2, 3], \"a\": 5}", parse_opts);
+
+  REQUIRE(result.has_value());
+
+  // The dropped array is kept alive by the source map, so new values cannot
+  // be allocated at it's address and be mistaken for it.
+  for (int i = 0; i < 100; ++i)
+  {
+    const auto fresh = array::make({ string::make(U"new") });
+
+    REQUIRE(!sources.find(fresh));
+    REQUIRE(!format(fresh, format_opts).compare("[\"new\"]"));
+  }
+  REQUIRE(!format(*result, format_opts).compare(
+    "{\"a\": [1, 2, 3], \"a\": 5}"
+  ));
+  REQUIRE(!format(
+    object::make({ { U"a", as<object>(*result)->get(U"a") } }),
+    format_opts
+  ).compare("{\"a\":5}"));
+}
+
+TEST_CASE("Integers and decimal digits are formatted exactly", "[format]")
+{
+  REQUIRE(!format(number::make(9007199254740993)).compare(
+    "9007199254740993"
+  ));
+  REQUIRE(!format(number::make(18446744073709551615ULL)).compare(
+    "18446744073709551615"
+  ));
+  REQUIRE(!format(number::make_digits("1.50e2")).compare("1.50e2"));
+
+  format_options options;
+
+  options.sort_keys = true;
+  REQUIRE(!format(number::make_digits("1.50e2"), options).compare("150"));
+}
+
+TEST_CASE("Source code which is not valid JSON is not copied", "[format]")
+{
+  source_map sources;
+  parse_options parse_opts;
+  format_options format_opts;
+
+  parse_opts.sources = &sources;
+  format_opts.sources = &sources;
+
+  const auto format_parsed = [&](const std::u32string& input)
+  {
+    return format(*parse(input, parse_opts), format_opts);
+  };
+
+  REQUIRE(!format_parsed(U"[\"a\\'b\", 1]").compare("[\"a'b\",1]"));
+  REQUIRE(!format_parsed(U"[1,\f2]").compare("[1,2]"));
+  REQUIRE(!format_parsed(U"[1,\v2]").compare("[1,2]"));
+  REQUIRE(!format_parsed(U"{\"a\":\"x\ty\"}").compare("{\"a\":\"x\\ty\"}"));
+  REQUIRE(!format_parsed(U"[\"a\", 1]").compare("[\"a\", 1]"));
+}
+
+TEST_CASE("Parsed numbers are formatted as valid JSON", "[format]")
+{
+  REQUIRE(!format(*parse(U"01.50")).compare("1.5"));
+  REQUIRE(!format(*parse(U"+1.50")).compare("1.5"));
+  REQUIRE(!format(*parse(U"-0")).compare("-0"));
+  REQUIRE(!format(*parse(U"-0.0")).compare("-0.0"));
+}
+
+TEST_CASE("Exception thrown by sink is propagated", "[format_to]")
+{
+  callback_sink sink([](const char*, std::size_t)
+  {
+    throw std::runtime_error("write failed");
+  });
+
+  REQUIRE_THROWS_AS(
+    format_to(sink, string::make(U"foo")),
+    std::runtime_error
+  );
+}
+
+TEST_CASE("ASCII output with surrogate pairs is parsed back", "[format]")
+{
+  const auto value = string::make(U"a\U0001f600b\u00e4");
+  const auto output = format(value);
+
+  REQUIRE(!output.compare("\"a\\ud83d\\ude00b\\u00e4\""));
+
+  const auto result = parse(std::u32string(output.begin(), output.end()));
+
+  REQUIRE(result.has_value());
+  REQUIRE(!as<string>(*result)->value().compare(U"a\U0001f600b\u00e4"));
+}
@@ -0,0 +1,65 @@
+#include <unordered_set>
+
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/hash.hpp>
+#include <peelo/json/parser.hpp>
+
+using namespace peelo::json;
+
+TEST_CASE("Structurally equal values are equal", "[equals]")
+{
+  const auto a = parse(U"{\"a\": [1, true, null], \"b\": {\"c\": \"d\"}}");
+  const auto b = parse(U"{\"b\": {\"c\": \"d\"}, \"a\": [1, true, null]}");
+
+  REQUIRE(a.has_value());
+  REQUIRE(b.has_value());
+  REQUIRE(equals(*a, *b));
+  REQUIRE(hash(*a) == hash(*b));
+  REQUIRE(equals(number::make(0.0), number::make(-0.0)));
+  REQUIRE(hash(number::make(0.0)) == hash(number::make(-0.0)));
+}
+
+TEST_CASE("Structurally different values are not equal", "[equals]")
+{
+  REQUIRE(!equals(number::make(1), boolean::make(true)));
+  REQUIRE(!equals(string::make(U"a"), string::make(U"b")));
+  REQUIRE(!equals(nullptr, array::make({})));
+  REQUIRE(!equals(
+    array::make({ number::make(1), number::make(2) }),
+    array::make({ number::make(2), number::make(1) })
+  ));
+  REQUIRE(!equals(
+    object::make({ { U"a", nullptr } }),
+    object::make({ { U"b", nullptr } })
+  ));
+  REQUIRE(
+    hash(array::make({ number::make(1), number::make(2) })) !=
+    hash(array::make({ number::make(2), number::make(1) }))
+  );
+}
+
+TEST_CASE("Hash is cached in the value", "[hash]")
+{
+  const auto value = array::make({ string::make(U"foo") });
+
+  REQUIRE(value->cached_hash() == 0);
+  REQUIRE(hash(value, false) != 0);
+  REQUIRE(value->cached_hash() == 0);
+
+  const auto result = hash(value);
+
+  REQUIRE(value->cached_hash() == result);
+  REQUIRE(value->elements()[0]->cached_hash() != 0);
+}
+
+TEST_CASE("Values can be used as keys of unordered containers", "[hash]")
+{
+  std::unordered_set<value, value_hash, value_equal> set;
+
+  set.insert(array::make({ number::make(1) }));
+  set.insert(array::make({ number::make(1) }));
+  set.insert(nullptr);
+
+  REQUIRE(set.size() == 2);
+  REQUIRE(set.find(array::make({ number::make(1) })) != std::end(set));
+}
@@ -0,0 +1,98 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/hash.hpp>
+#include <peelo/json/msgpack.hpp>
+#include <peelo/json/parser.hpp>
+
+using namespace peelo::json;
+
+using bytes = std::vector<std::uint8_t>;
+
+TEST_CASE("Scalars are encoded in MessagePack", "[msgpack]")
+{
+  REQUIRE(encode_msgpack(nullptr) == bytes{ 0xc0 });
+  REQUIRE(encode_msgpack(boolean::make(false)) == bytes{ 0xc2 });
+  REQUIRE(encode_msgpack(number::make(127)) == bytes{ 0x7f });
+  REQUIRE(encode_msgpack(number::make(128)) == bytes{ 0xcc, 0x80 });
+  REQUIRE(encode_msgpack(number::make(-32)) == bytes{ 0xe0 });
+  REQUIRE(encode_msgpack(number::make(-33)) == bytes{ 0xd0, 0xdf });
+  REQUIRE(
+    encode_msgpack(number::make(-1000)) ==
+    bytes{ 0xd1, 0xfc, 0x18 }
+  );
+  REQUIRE(
+    encode_msgpack(number::make(1.5)) ==
+    bytes{ 0xcb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0 }
+  );
+  REQUIRE(encode_msgpack(string::make(U"ab")) == bytes{ 0xa2, 0x61, 0x62 });
+}
+
+TEST_CASE("Containers are encoded in MessagePack", "[msgpack]")
+{
+  REQUIRE(
+    encode_msgpack(array::make({ number::make(1), nullptr })) ==
+    bytes{ 0x92, 0x01, 0xc0 }
+  );
+  REQUIRE(
+    encode_msgpack(object::make({ { U"a", boolean::make(true) } })) ==
+    bytes{ 0x81, 0xa1, 0x61, 0xc3 }
+  );
+}
+
+TEST_CASE("Values survive MessagePack round trip", "[msgpack]")
+{
+  const auto document = parse(
+    U"{\"a\": [1, -200, 70000, -3000000000, 3.25, 18446744073709551615],"
+    U"\"b\": {\"c\": null, \"d\": true, \"e\": \"ä\U0001f600\"}}"
+  );
+
+  REQUIRE(document.has_value());
+
+  const auto result = decode_msgpack(encode_msgpack(*document));
+
+  REQUIRE(result.has_value());
+  REQUIRE(equals(*result, *document));
+}
+
+TEST_CASE("Long strings and arrays are round tripped", "[msgpack]")
+{
+  array::container_type elements;
+
+  for (int i = 0; i < 70000; ++i)
+  {
+    elements.push_back(number::make(i));
+  }
+
+  const auto document = array::make({
+    string::make(std::u32string(300, U'x')),
+    array::make(elements),
+  });
+  const auto result = decode_msgpack(encode_msgpack(document));
+
+  REQUIRE(result.has_value());
+  REQUIRE(equals(*result, document));
+}
+
+TEST_CASE("Malformed MessagePack produces error", "[msgpack]")
+{
+  REQUIRE(!decode_msgpack(bytes{ 0x92, 0x01 }).has_value());
+  REQUIRE(!decode_msgpack(bytes{ 0xa2, 0x61 }).has_value());
+  REQUIRE(!decode_msgpack(bytes{ 0x81, 0x01, 0x01 }).has_value());
+  REQUIRE(!decode_msgpack(bytes{ 0xc4, 0x00 }).has_value());
+  REQUIRE(!decode_msgpack(bytes{ 0xcd, 0x01 }).has_value());
+  REQUIRE(!decode_msgpack(bytes{ 0xc0, 0xc0 }).has_value());
+}
+
+TEST_CASE("Deeply nested MessagePack produces error", "[msgpack]")
+{
+  auto nested = bytes(512, 0x91);
+
+  nested.push_back(0x90);
+  REQUIRE(decode_msgpack(nested).has_value());
+
+  const auto result = decode_msgpack(bytes(1000000, 0x91));
+
+  REQUIRE(!result.has_value());
+  REQUIRE(
+    std::string(result.error().what()) == "Maximum nesting depth exceeded."
+  );
+}
@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/parallel.hpp>
+
+using namespace peelo::json;
+
+static value
+make_document()
+{
+  array::container_type elements;
+
+  for (int i = 0; i < 500; ++i)
+  {
+    object::container_type properties;
+
+    for (int j = 0; j < i % 20; ++j)
+    {
+      properties[object::key_type(1, U'a' + j)] = number::make(i * j);
+    }
+    properties[U"name"] = string::make(U"ä\n");
+    properties[U"flags"] = array::make({ boolean::make(i % 2), nullptr });
+    elements.push_back(object::make(properties));
+  }
+
+  return array::make(elements);
+}
+
+TEST_CASE("Parallel output is identical to format()", "[parallel_format]")
+{
+  thread_pool pool(4);
+  const auto document = make_document();
+
+  REQUIRE(!parallel_format(pool, document).compare(format(document)));
+  REQUIRE(
+    !parallel_format(pool, document, format_options(), 7)
+      .compare(format(document))
+  );
+}
+
+TEST_CASE("Parallel output respects format options", "[parallel_format]")
+{
+  thread_pool pool(2);
+  const auto document = make_document();
+  format_options options;
+
+  options.encoding = format_encoding::utf8;
+  options.sort_keys = true;
+
+  REQUIRE(
+    !parallel_format(pool, document, options, 3)
+      .compare(format(document, options))
+  );
+  REQUIRE(!parallel_format(pool, nullptr).compare("null"));
+}
+
+namespace
+{
+  struct counting_visitor
+  {
+    std::size_t nodes = 0;
+    double sum = 0;
+
+    void visit_array(const array::container_type&)
+    {
+      ++nodes;
+    }
+
+    void visit_boolean(bool)
+    {
+      ++nodes;
+    }
+
+    void visit_null()
+    {
+      ++nodes;
+    }
+
+    void visit_number(double value)
+    {
+      ++nodes;
+      sum += value;
+    }
+
+    void visit_object(const object::container_type&)
+    {
+      ++nodes;
+    }
+
+    void visit_string(const string::value_type&)
+    {
+      ++nodes;
+    }
+  };
+}
+
+TEST_CASE("Parallel traversal visits every value", "[parallel_accept]")
+{
+  thread_pool pool(4);
+  const auto document = make_document();
+  const auto reduce = [](counting_visitor& into, counting_visitor&& from)
+  {
+    into.nodes += from.nodes;
+    into.sum += from.sum;
+  };
+  const auto serial = parallel_accept(
+    pool,
+    document,
+    counting_visitor(),
+    reduce,
+    1000000
+  );
+  const auto parallel = parallel_accept(
+    pool,
+    document,
+    counting_visitor(),
+    reduce,
+    7
+  );
+
+  REQUIRE(serial.nodes == parallel.nodes);
+  REQUIRE(serial.sum == parallel.sum);
+  REQUIRE(serial.nodes > 500 * 5);
+}
@@ -1,8 +1,39 @@
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
 #include <catch2/catch_test_macros.hpp>
 #include <peelo/json/parser.hpp>
 
 using namespace peelo::json;
 
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment)
+  {
+    ++allocations;
+
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+  {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& that) const noexcept
+  {
+    return this == &that;
+  }
+};
+
 TEST_CASE("False boolean value is parsed", "[parse]")
 {
   const auto result = parse(U"false");
@@ -222,3 +253,244 @@ TEST_CASE("Parsing object with non-object input produces error", "[parse]")
 
   REQUIRE(!result.has_value());
 }
+
+TEST_CASE("Values are allocated from given memory resource", "[parse]")
+{
+  counting_resource resource;
+
+  {
+    parse_options options;
+
+    options.resource = &resource;
+
+    const auto result = parse(
+      U"{\"foo\": [\"a long string value\", 1, true]}",
+      options
+    );
+
+    REQUIRE(result.has_value());
+
+    const auto obj = as<object>(*result);
+    const auto& properties = obj->properties();
+    const auto& elements = as<array>(properties.at(U"foo"))->elements();
+    const auto str = as<string>(elements[0]);
+
+    REQUIRE(properties.get_allocator().resource() == &resource);
+    REQUIRE(elements.get_allocator().resource() == &resource);
+    REQUIRE(str->value().get_allocator().resource() == &resource);
+    REQUIRE(resource.allocations > 0);
+  }
+
+  REQUIRE(resource.allocations == resource.deallocations);
+}
+
+TEST_CASE("Source code of values is recorded in source map", "[parse]")
+{
+  source_map sources;
+  parse_options options;
+
+  options.sources = &sources;
+
+  const auto result = parse(U" { \"a\" : [ 1.50 , \"\\u0041\" ] } ", options);
+
+  REQUIRE(result.has_value());
+
+  const auto& elements = as<array>(
+    as<object>(*result)->properties().at(U"a")
+  )->elements();
+
+  REQUIRE(sources.size() == 4);
+  REQUIRE(sources.text(*result) == U"{ \"a\" : [ 1.50 , \"\\u0041\" ] }");
+  REQUIRE(sources.text(elements[0]) == U"1.50");
+  REQUIRE(sources.text(elements[1]) == U"\"\\u0041\"");
+  REQUIRE(sources.find(number::make(1.5)) == nullptr);
+}
+
+TEST_CASE("Source map is cleared when parsing fails", "[parse]")
+{
+  source_map sources;
+  parse_options options;
+
+  options.sources = &sources;
+
+  REQUIRE(!parse(U"[1, 2", options).has_value());
+  REQUIRE(sources.size() == 0);
+  REQUIRE(sources.source().empty());
+}
+
+TEST_CASE("Large integers are parsed exactly", "[parse]")
+{
+  const auto result = parse(U"[9007199254740993, -9223372036854775808, "
+                            U"18446744073709551615]");
+
+  REQUIRE(result.has_value());
+
+  const auto& elements = as<array>(*result)->elements();
+
+  REQUIRE(as<number>(elements[0])->kind() == number::kind::int64);
+  REQUIRE(*as<number>(elements[0])->as_int64() == 9007199254740993);
+  REQUIRE(
+    *as<number>(elements[1])->as_int64() ==
+    std::numeric_limits<std::int64_t>::min()
+  );
+  REQUIRE(as<number>(elements[2])->kind() == number::kind::uint64);
+  REQUIRE(!as<number>(elements[2])->as_int64());
+  REQUIRE(
+    *as<number>(elements[2])->as_uint64() ==
+    std::numeric_limits<std::uint64_t>::max()
+  );
+}
+
+TEST_CASE("Decimal digits are converted on demand", "[parse]")
+{
+  const auto result = parse(U"12.50");
+
+  REQUIRE(result.has_value());
+
+  const auto n = as<number>(*result);
+
+  REQUIRE(n->kind() == number::kind::digits);
+  REQUIRE(n->digits() == "12.50");
+  REQUIRE(n->value() == 12.5);
+  REQUIRE(!n->as_int64());
+}
+
+TEST_CASE("Decimal digits too small for double become zero", "[parse]")
+{
+  const auto result = parse(U"0." + std::u32string(400, U'0') + U"1");
+
+  REQUIRE(result.has_value());
+  REQUIRE(as<number>(*result)->value() == 0.0);
+  REQUIRE(!parse(U"-1" + std::u32string(400, U'0')).has_value());
+}
+
+TEST_CASE("Numbers which are not valid JSON are not kept as digits", "[parse]")
+{
+  const auto result = parse(U"[01.5, +2.5, -0, 007]");
+
+  REQUIRE(result.has_value());
+
+  const auto& elements = as<array>(*result)->elements();
+
+  REQUIRE(as<number>(elements[0])->kind() == number::kind::floating);
+  REQUIRE(as<number>(elements[0])->value() == 1.5);
+  REQUIRE(as<number>(elements[1])->kind() == number::kind::floating);
+  REQUIRE(as<number>(elements[1])->value() == 2.5);
+  REQUIRE(as<number>(elements[2])->kind() == number::kind::floating);
+  REQUIRE(std::signbit(as<number>(elements[2])->value()));
+  REQUIRE(*as<number>(elements[3])->as_int64() == 7);
+}
+
+TEST_CASE("Numbers which are not valid JSON are not in source map", "[parse]")
+{
+  source_map sources;
+  parse_options options;
+
+  options.sources = &sources;
+
+  const auto result = parse(U"[[1], [+1], 01]", options);
+
+  REQUIRE(result.has_value());
+
+  const auto& elements = as<array>(*result)->elements();
+
+  REQUIRE(sources.text(elements[0]) == U"[1]");
+  REQUIRE(sources.text(elements[1]).empty());
+  REQUIRE(sources.text(elements[2]).empty());
+  REQUIRE(sources.text(*result).empty());
+}
+
+TEST_CASE("UTF-8 stream input is parsed", "[parse]")
+{
+  std::istringstream stream(
+    "\xef\xbb\xbf {\"name\": \"\xc3\xa4\xf0\x9f\x98\x80\", "
+    "\"escape\": \"\\u0041\\n\"}"
+  );
+  istream_input in(stream);
+  const auto result = parse_object(in);
+
+  REQUIRE(result.has_value());
+  REQUIRE(
+    !as<string>((*result)->get(U"name"))->value().compare(U"\u00e4\U0001f600")
+  );
+  REQUIRE(!as<string>((*result)->get(U"escape"))->value().compare(U"A\n"));
+}
+
+TEST_CASE("Large input is parsed through the buffer", "[parse]")
+{
+  std::string source("[");
+
+  for (int i = 0; i < 3000; ++i)
+  {
+    source.append(i > 0 ? ", \"\xc3\xa4\xe2\x82\xac\"" : "\"\"");
+  }
+  source.append("]");
+
+  std::istringstream stream(source);
+  istream_input in(stream);
+  const auto result = parse(in);
+
+  REQUIRE(result.has_value());
+
+  const auto& elements = as<array>(*result)->elements();
+
+  REQUIRE(elements.size() == 3000);
+  REQUIRE(!as<string>(elements[2999])->value().compare(U"\u00e4\u20ac"));
+}
+
+TEST_CASE("Invalid UTF-8 input produces error", "[parse]")
+{
+  std::istringstream truncated("\"\xc3");
+  std::istringstream trailing("1 \xff");
+  istream_input truncated_in(truncated);
+  istream_input trailing_in(trailing);
+
+  REQUIRE(!parse(truncated_in).has_value());
+  REQUIRE(!parse(trailing_in).has_value());
+}
+
+TEST_CASE("Input with trailing garbage produces error", "[parse]")
+{
+  std::istringstream stream("[1, 2] 3");
+  istream_input in(stream);
+
+  REQUIRE(!parse(in).has_value());
+}
+
+TEST_CASE("File and file descriptor inputs are parsed", "[parse]")
+{
+  auto file = std::tmpfile();
+
+  REQUIRE(file);
+  std::fputs("{\"a\": [true, null]}", file);
+  std::rewind(file);
+
+  {
+    file_input in(file);
+    const auto result = parse(in);
+
+    REQUIRE(result.has_value());
+    REQUIRE(type_of(*result) == type::object);
+  }
+
+  std::rewind(file);
+
+  {
+    fd_input in(fileno(file));
+    const auto result = parse_object(in);
+
+    REQUIRE(result.has_value());
+    REQUIRE((*result)->properties().size() == 1);
+    REQUIRE(!in.failed());
+  }
+
+  std::fclose(file);
+}
+
+TEST_CASE("Unpaired surrogate escape produces error", "[parse]")
+{
+  REQUIRE(parse(U"\"\\ud83d\\ude00\"").has_value());
+  REQUIRE(!parse(U"\"\\ud83d\"").has_value());
+  REQUIRE(!parse(U"\"\\ud83d\\u0041\"").has_value());
+  REQUIRE(!parse(U"\"\\ude00\"").has_value());
+}
@@ -0,0 +1,157 @@
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/update.hpp>
+
+using namespace peelo::json;
+
+static std::u32string
+name_of(int i)
+{
+  std::u32string result;
+
+  for (const auto c : std::to_string(i))
+  {
+    result.append(1, static_cast<char32_t>(c));
+  }
+
+  return result;
+}
+
+TEST_CASE(
+  "Persistent array is updated without modifying old versions",
+  "[persistent]"
+)
+{
+  std::vector<persistent_array> versions = { persistent_array() };
+
+  for (int i = 0; i < 2000; ++i)
+  {
+    versions.push_back(push(versions.back(), number::make(i)));
+  }
+  REQUIRE(versions.back().size() == 2000);
+  for (std::size_t i = 0; i < versions.size(); ++i)
+  {
+    REQUIRE(versions[i].size() == i);
+  }
+  for (int i = 0; i < 2000; ++i)
+  {
+    REQUIRE(*as<number>(versions.back()[i])->as_int64() == i);
+  }
+
+  const auto updated = *with(versions.back(), 1234, nullptr);
+
+  REQUIRE(updated[1234] == nullptr);
+  REQUIRE(updated[1233] == versions.back()[1233]);
+  REQUIRE(*as<number>(versions.back()[1234])->as_int64() == 1234);
+  REQUIRE(!with(updated, 2000, nullptr));
+}
+
+TEST_CASE("Persistent array is converted to and from array", "[persistent]")
+{
+  array::container_type elements;
+
+  for (int i = 0; i < 1100; ++i)
+  {
+    elements.push_back(number::make(i));
+  }
+
+  const auto arr = array::make(elements);
+  const auto persistent = push(persistent_array(*arr), nullptr);
+  const auto result = persistent.to_array();
+
+  REQUIRE(persistent.size() == 1101);
+  REQUIRE(result->elements().size() == 1101);
+  REQUIRE(result->elements()[1099] == elements[1099]);
+  REQUIRE(result->elements()[1100] == nullptr);
+  REQUIRE(persistent_array(*array::make({})).to_array()->elements().empty());
+}
+
+TEST_CASE(
+  "Persistent object is updated without modifying old versions",
+  "[persistent]"
+)
+{
+  persistent_object obj;
+
+  for (int i = 0; i < 5000; ++i)
+  {
+    obj = with(obj, key(name_of(i)), number::make(i));
+  }
+
+  const auto removed = without(obj, U"42");
+  const auto replaced = with(removed, U"43", nullptr);
+
+  REQUIRE(obj.size() == 5000);
+  REQUIRE(removed.size() == 4999);
+  REQUIRE(replaced.size() == 4999);
+  for (int i = 0; i < 5000; ++i)
+  {
+    REQUIRE(*as<number>(obj.get(key(name_of(i))))->as_int64() == i);
+  }
+  REQUIRE(!removed.find(U"42"));
+  REQUIRE(obj.find(U"42"));
+  REQUIRE(replaced.find(U"43"));
+  REQUIRE(*replaced.find(U"43") == nullptr);
+  REQUIRE(type_of(removed.get(U"43")) == type::number);
+  REQUIRE(!obj.find(U"5000"));
+  REQUIRE(without(obj, U"5000").size() == 5000);
+
+  persistent_object emptied = obj;
+
+  for (int i = 0; i < 5000; ++i)
+  {
+    emptied = without(emptied, key(name_of(i)));
+  }
+  REQUIRE(emptied.empty());
+  REQUIRE(!emptied.find(U"0"));
+}
+
+TEST_CASE("Persistent object is converted to and from object", "[persistent]")
+{
+  const auto obj = object::make({
+    { U"a", number::make(1) },
+    { U"b", string::make(U"x") },
+  });
+  const auto result = with(persistent_object(*obj), U"c", nullptr).to_object();
+
+  REQUIRE(result->properties().size() == 3);
+  REQUIRE(result->get(U"a") == obj->get(U"a"));
+  REQUIRE(result->find(U"c"));
+}
+
+TEST_CASE("Colliding hashes are stored in persistent object", "[persistent]")
+{
+  using namespace internal;
+  auto* resource = std::pmr::get_default_resource();
+  map_node_ptr root;
+  bool changed = false;
+
+  for (const auto name : { U"a", U"b", U"c" })
+  {
+    root = map_assoc(
+      root.get(),
+      0,
+      make_node<map_leaf>(resource, 7, name, nullptr, resource),
+      resource,
+      changed
+    );
+  }
+
+  REQUIRE(map_find(root.get(), 7, U"a"));
+  REQUIRE(map_find(root.get(), 7, U"c"));
+  REQUIRE(!map_find(root.get(), 7, U"d"));
+
+  changed = false;
+  root = map_dissoc(root.get(), 0, 7, U"b", resource, changed);
+  REQUIRE(changed);
+  REQUIRE(!map_find(root.get(), 7, U"b"));
+  REQUIRE(map_find(root.get(), 7, U"a"));
+  REQUIRE(map_find(root.get(), 7, U"c"));
+
+  root = map_dissoc(root.get(), 0, 7, U"a", resource, changed);
+  REQUIRE(!root->nodemap);
+  REQUIRE(root->slots.size() == 1);
+  REQUIRE(map_find(root.get(), 7, U"c"));
+}
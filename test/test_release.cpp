@@ -0,0 +1,63 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/release.hpp>
+
+using namespace peelo::json;
+
+namespace
+{
+  value make_nested(int depth)
+  {
+    value result;
+
+    for (int i = 0; i < depth; ++i)
+    {
+      if (i % 2)
+      {
+        result = array::make({ result, number::make(i) });
+      } else {
+        result = object::make({ { U"a", result } });
+      }
+    }
+
+    return result;
+  }
+}
+
+TEST_CASE("Deeply nested values are destroyed without recursion", "[release]")
+{
+  auto v = make_nested(1000000);
+
+  v = nullptr;
+
+  REQUIRE(v == nullptr);
+}
+
+TEST_CASE("Shared children survive destruction of parent", "[release]")
+{
+  const auto child = array::make({ array::make({ number::make(1) }) });
+  auto parent = array::make({ child, object::make({ { U"a", child } }) });
+
+  parent = nullptr;
+
+  REQUIRE(child->elements().size() == 1);
+  REQUIRE(as<array>(child->elements()[0])->elements().size() == 1);
+}
+
+TEST_CASE("Values are destroyed in the background", "[release]")
+{
+  release_queue queue;
+  const auto shared = make_nested(10);
+  std::weak_ptr<internal::base> weak;
+
+  {
+    auto v = make_nested(1000);
+
+    weak = v;
+    queue.release(std::move(v));
+  }
+  queue.release(shared);
+  queue.flush();
+
+  REQUIRE(weak.expired());
+  REQUIRE(shared.use_count() == 1);
+}
@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <limits>
+
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/hash.hpp>
+#include <peelo/json/parser.hpp>
+#include <peelo/json/snapshot.hpp>
+
+using namespace peelo::json;
+
+static value
+make_document()
+{
+  return *parse(
+    U"{\"name\": \"snapshot\", \"id\": -42, \"big\": 18446744073709551615, "
+    U"\"ratio\": 0.25, \"flags\": [true, false, null], "
+    U"\"nested\": [{\"name\": \"a\"}, {\"name\": \"b\"}], \"empty\": {}}"
+  );
+}
+
+TEST_CASE("Snapshot is navigated in place", "[snapshot]")
+{
+  const auto bytes = snapshot::write(make_document());
+  const auto result = snapshot::view(bytes.data(), bytes.size());
+
+  REQUIRE(result.has_value());
+
+  const auto root = (*result)->root();
+
+  REQUIRE(root.type() == type::object);
+  REQUIRE(root.size() == 7);
+  REQUIRE(root.find(U"name")->as_string() == U"snapshot");
+  REQUIRE(root.find(U"id")->as_number() == -42);
+  REQUIRE(root.find(U"ratio")->as_number() == 0.25);
+  REQUIRE(root.find(U"empty")->size() == 0);
+  REQUIRE(!root.find(U"missing"));
+
+  const auto flags = *root.find(U"flags");
+
+  REQUIRE(flags.type() == type::array);
+  REQUIRE(flags.size() == 3);
+  REQUIRE(flags[0].as_boolean());
+  REQUIRE(!flags[1].as_boolean());
+  REQUIRE(flags[2].type() == type::null);
+  REQUIRE((*root.find(U"nested"))[1].find(U"name")->as_string() == U"b");
+  REQUIRE(root.key(0) == U"big");
+}
+
+TEST_CASE("Snapshot converts back into equal value", "[snapshot]")
+{
+  const auto document = make_document();
+  const auto bytes = snapshot::write(document);
+  const auto result = snapshot::view(bytes.data(), bytes.size());
+
+  REQUIRE(result.has_value());
+
+  const auto copy = (*result)->root().to_value();
+  const auto big = as<number>(as<object>(copy)->get(U"big"));
+
+  REQUIRE(equals(copy, document));
+  REQUIRE(*big->as_uint64() == std::numeric_limits<std::uint64_t>::max());
+}
+
+TEST_CASE("Snapshot is opened from a file", "[snapshot]")
+{
+  const auto bytes = snapshot::write(make_document());
+  const auto path = std::string(std::tmpnam(nullptr));
+  auto file = std::fopen(path.c_str(), "wb");
+
+  REQUIRE(file);
+  std::fwrite(bytes.data(), 1, bytes.size(), file);
+  std::fclose(file);
+
+  {
+    const auto result = snapshot::open(path);
+
+    REQUIRE(result.has_value());
+    REQUIRE((*result)->size() == bytes.size());
+    REQUIRE(equals((*result)->root().to_value(), make_document()));
+  }
+
+  std::remove(path.c_str());
+  REQUIRE(!snapshot::open(path).has_value());
+}
+
+TEST_CASE("Invalid snapshots are rejected", "[snapshot]")
+{
+  auto bytes = snapshot::write(nullptr);
+
+  REQUIRE(snapshot::view(bytes.data(), bytes.size()).has_value());
+  REQUIRE(!snapshot::view(bytes.data(), 8).has_value());
+  bytes[0] = 'X';
+  REQUIRE(!snapshot::view(bytes.data(), bytes.size()).has_value());
+}
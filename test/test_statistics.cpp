@@ -0,0 +1,99 @@
+#if !defined(PEELO_JSON_ENABLE_STATISTICS)
+# define PEELO_JSON_ENABLE_STATISTICS
+#endif
+
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/parser.hpp>
+
+using namespace peelo::json;
+
+class my_observer : public parse_observer
+{
+public:
+  int call_count;
+  parse_statistics statistics;
+
+  explicit my_observer()
+    : call_count(0) {}
+
+  void on_parse(const parse_statistics& stats)
+  {
+    ++call_count;
+    statistics = stats;
+  }
+};
+
+TEST_CASE("Observer receives node counts", "[statistics]")
+{
+  my_observer observer;
+  const auto result = parse(
+    U"{\"a\": [1, 2, true, null], \"b\": \"foo\"}",
+    parse_options{ &observer }
+  );
+
+  REQUIRE(result.has_value());
+  REQUIRE(observer.call_count == 1);
+  REQUIRE(observer.statistics.nodes(type::object) == 1);
+  REQUIRE(observer.statistics.nodes(type::array) == 1);
+  REQUIRE(observer.statistics.nodes(type::number) == 2);
+  REQUIRE(observer.statistics.nodes(type::boolean) == 1);
+  REQUIRE(observer.statistics.nodes(type::null) == 1);
+  REQUIRE(observer.statistics.nodes(type::string) == 1);
+  REQUIRE(observer.statistics.nodes() == 7);
+  REQUIRE(observer.statistics.node_allocations == 6);
+}
+
+TEST_CASE("Observer receives maximum depth", "[statistics]")
+{
+  my_observer observer;
+
+  const auto result = parse(
+    U"[[[1], []], {\"a\": {}}]",
+    parse_options{ &observer }
+  );
+
+  REQUIRE(result.has_value());
+  REQUIRE(observer.statistics.max_depth == 3);
+}
+
+TEST_CASE("Observer receives string bytes", "[statistics]")
+{
+  my_observer observer;
+
+  const auto result = parse(U"{\"ab\": \"cde\"}", parse_options{ &observer });
+
+  REQUIRE(result.has_value());
+  REQUIRE(observer.statistics.string_bytes == 5 * sizeof(char32_t));
+}
+
+TEST_CASE("Observer receives routine times", "[statistics]")
+{
+  my_observer observer;
+
+  const auto result = parse(U"[1, \"a\"]", parse_options{ &observer });
+
+  REQUIRE(result.has_value());
+  REQUIRE(
+    observer.statistics.time(parse_routine::value) >=
+    observer.statistics.time(parse_routine::array)
+  );
+  REQUIRE(
+    observer.statistics.time(parse_routine::array) >=
+    observer.statistics.time(parse_routine::number)
+  );
+  REQUIRE(
+    observer.statistics.time(parse_routine::object) ==
+    parse_statistics::duration::zero()
+  );
+}
+
+TEST_CASE("Observer is notified of failed parse", "[statistics]")
+{
+  my_observer observer;
+
+  const auto result = parse(U"[1, 2", parse_options{ &observer });
+
+  REQUIRE(!result.has_value());
+  REQUIRE(observer.call_count == 1);
+  REQUIRE(observer.statistics.nodes(type::number) == 2);
+}
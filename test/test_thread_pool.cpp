@@ -0,0 +1,93 @@
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+#include <thread>
+
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/thread_pool.hpp>
+
+using namespace peelo::json;
+
+TEST_CASE("Tasks of a group are executed", "[thread_pool]")
+{
+  thread_pool pool(4);
+  task_group group(pool);
+  std::atomic<int> counter(0);
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    group.run([&counter]() { ++counter; });
+  }
+  group.wait();
+
+  REQUIRE(pool.size() == 4);
+  REQUIRE(counter == 1000);
+}
+
+TEST_CASE("Task groups can be waited for from tasks", "[thread_pool]")
+{
+  thread_pool pool(2);
+  task_group group(pool);
+  std::atomic<int> counter(0);
+
+  for (int i = 0; i < 10; ++i)
+  {
+    group.run([&pool, &counter]()
+    {
+      task_group nested(pool);
+
+      for (int j = 0; j < 10; ++j)
+      {
+        nested.run([&counter]() { ++counter; });
+      }
+      nested.wait();
+    });
+  }
+  group.wait();
+
+  REQUIRE(counter == 100);
+}
+
+TEST_CASE("Exception thrown by a task is rethrown by wait", "[thread_pool]")
+{
+  thread_pool pool(2);
+  task_group group(pool);
+  std::atomic<int> counter(0);
+
+  for (int i = 0; i < 100; ++i)
+  {
+    group.run([&counter, i]()
+    {
+      if (i == 50)
+      {
+        throw std::runtime_error("task failed");
+      }
+      ++counter;
+    });
+  }
+
+  REQUIRE_THROWS_AS(group.wait(), std::runtime_error);
+  REQUIRE(counter == 99);
+  REQUIRE_NOTHROW(group.wait());
+}
+
+TEST_CASE("Waiting for a long task blocks", "[thread_pool]")
+{
+  thread_pool pool(1);
+  task_group group(pool);
+  std::atomic<bool> done(false);
+  const auto start = std::clock();
+
+  group.run([&done]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    done = true;
+  });
+  group.wait();
+
+  REQUIRE(done);
+  // Processor time used by the whole process stays well below the time
+  // spent waiting.
+  REQUIRE(std::clock() - start < CLOCKS_PER_SEC / 10);
+}
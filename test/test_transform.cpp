@@ -0,0 +1,66 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/transform.hpp>
+#include <peelo/json/update.hpp>
+
+using namespace peelo::json;
+
+TEST_CASE("Unchanged value is reused", "[transform]")
+{
+  const auto document = array::make({
+    object::make({ { U"a", number::make(1) } }),
+    string::make(U"b"),
+  });
+
+  REQUIRE(transform(document, [](const value& v) { return v; }) == document);
+}
+
+TEST_CASE("Properties are removed from objects", "[transform]")
+{
+  const auto untouched = array::make({ number::make(1), number::make(2) });
+  const auto document = object::make({
+    { U"untouched", untouched },
+    {
+      U"user",
+      object::make({
+        { U"name", string::make(U"test") },
+        { U"password", string::make(U"secret") },
+      })
+    },
+  });
+  const auto result = as<object>(transform(document, [](const value& v)
+  {
+    if (type_of(v) == type::object)
+    {
+      return value(without(as<object>(v), U"password"));
+    }
+
+    return v;
+  }));
+
+  REQUIRE(result != document);
+  REQUIRE(result->properties().at(U"untouched") == untouched);
+
+  const auto user = as<object>(result->properties().at(U"user"));
+
+  REQUIRE(user->properties().size() == 1);
+  REQUIRE(user->properties().count(U"name") == 1);
+}
+
+TEST_CASE("Values are replaced", "[transform]")
+{
+  const auto first = string::make(U"first");
+  const auto document = array::make({ first, number::make(2) });
+  const auto result = as<array>(transform(document, [](const value& v)
+  {
+    if (type_of(v) == type::number)
+    {
+      return value(number::make(as<number>(v)->value() * 2));
+    }
+
+    return v;
+  }));
+
+  REQUIRE(result->elements()[0] == first);
+  REQUIRE(as<number>(result->elements()[1])->value() == 4);
+  REQUIRE(as<number>(document->elements()[1])->value() == 2);
+}
@@ -0,0 +1,61 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/update.hpp>
+
+using namespace peelo::json;
+
+TEST_CASE("Property of object is replaced", "[update]")
+{
+  const auto child = array::make({ number::make(1) });
+  const auto obj = object::make({
+    { U"a", child },
+    { U"b", number::make(2) },
+  });
+  const auto result = with(obj, U"b", number::make(3));
+
+  REQUIRE(result != obj);
+  REQUIRE(result->properties().size() == 2);
+  REQUIRE(result->properties().at(U"a") == child);
+  REQUIRE(as<number>(result->properties().at(U"b"))->value() == 3);
+  REQUIRE(as<number>(obj->properties().at(U"b"))->value() == 2);
+  REQUIRE(with(result, U"a", child) == result);
+}
+
+TEST_CASE("Property of object is added and removed", "[update]")
+{
+  const auto obj = object::make({ { U"a", number::make(1) } });
+  const auto added = with(obj, U"b", nullptr);
+
+  REQUIRE(added->properties().size() == 2);
+  REQUIRE(obj->properties().size() == 1);
+
+  const auto removed = without(added, U"a");
+
+  REQUIRE(removed->properties().size() == 1);
+  REQUIRE(removed->properties().count(U"b") == 1);
+  REQUIRE(without(removed, U"a") == removed);
+}
+
+TEST_CASE("Element of array is replaced and appended", "[update]")
+{
+  const auto first = string::make(U"first");
+  const auto arr = array::make({ first, number::make(2) });
+  const auto replaced = *with(arr, 1, boolean::make(true));
+  const auto pushed = push(replaced, nullptr);
+
+  REQUIRE(replaced->elements()[0] == first);
+  REQUIRE(type_of(replaced->elements()[1]) == type::boolean);
+  REQUIRE(type_of(arr->elements()[1]) == type::number);
+  REQUIRE(pushed->elements().size() == 3);
+  REQUIRE(pushed->elements()[0] == first);
+  REQUIRE(replaced->elements().size() == 2);
+}
+
+TEST_CASE("Replacing element out of bounds returns nothing", "[update]")
+{
+  const auto arr = array::make({ number::make(1) });
+
+  REQUIRE(!with(arr, 1, nullptr));
+  REQUIRE(!with(array::make({}), 0, nullptr));
+  REQUIRE(*with(arr, 0, nullptr) != nullptr);
+  REQUIRE(arr->elements().size() == 1);
+}
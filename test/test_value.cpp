@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+#include <peelo/json/value.hpp>
+
+using namespace peelo::json;
+
+class counting_resource : public std::pmr::memory_resource
+{
+public:
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment)
+  {
+    ++allocations;
+
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+
+  void do_deallocate(void* p, std::size_t bytes, std::size_t alignment)
+  {
+    ++deallocations;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource& that) const noexcept
+  {
+    return this == &that;
+  }
+};
+
+TEST_CASE("Property is looked up with prehashed key", "[value]")
+{
+  static constexpr key foo(U"foo");
+  const auto obj = object::make({
+    { U"foo", number::make(1) },
+    { U"bar", nullptr },
+  });
+
+  static_assert(foo.hash() == internal::hash_key(U"foo"));
+  REQUIRE(obj->find(foo));
+  REQUIRE(as<number>(*obj->find(foo))->value() == 1);
+  REQUIRE(obj->find(U"bar"));
+  REQUIRE(!obj->find(U"baz"));
+}
+
+TEST_CASE("Property is looked up from large object", "[value]")
+{
+  object::container_type properties;
+
+  for (char32_t c = U'a'; c <= U'z'; ++c)
+  {
+    for (char32_t d = U'a'; d <= U'z'; ++d)
+    {
+      properties[std::pmr::u32string({ c, d })] = nullptr;
+    }
+  }
+
+  const auto obj = object::make(properties);
+
+  for (const auto& property : obj->properties())
+  {
+    REQUIRE(obj->find(std::u32string_view(property.first)));
+  }
+  REQUIRE(!obj->find(U"aaa"));
+  REQUIRE(!obj->find(U""));
+  REQUIRE(!object::make({})->find(U"a"));
+}
+
+TEST_CASE("Missing property is returned as null", "[value]")
+{
+  const auto obj = object::make({ { U"foo", boolean::make(true) } });
+  const std::u32string name(U"foo");
+
+  REQUIRE(type_of(obj->get(std::u32string_view(name))) == type::boolean);
+  REQUIRE(type_of(obj->get(U"bar")) == type::null);
+}
+
+TEST_CASE("Value is cast into reference", "[value]")
+{
+  const value v = array::make({ string::make(U"foo") });
+  const auto count = v.use_count();
+  const auto& arr = as_ref<array>(v);
+
+  REQUIRE(&arr == v.get());
+  REQUIRE(v.use_count() == count);
+  REQUIRE(arr.elements().size() == 1);
+  REQUIRE(!as_ref<string>(arr.elements()[0]).value().compare(U"foo"));
+}
+
+TEST_CASE("Value is returned into it's memory resource", "[value]")
+{
+  counting_resource resource;
+
+  {
+    const value element = string::make(U"foo", &resource);
+    value v = array::make({ element }, &resource);
+    const auto copy = v;
+
+    REQUIRE(v.use_count() == 2);
+    REQUIRE(element.use_count() == 2);
+    v = nullptr;
+    REQUIRE(copy.use_count() == 1);
+  }
+
+  REQUIRE(resource.allocations > 0);
+  REQUIRE(resource.allocations == resource.deallocations);
+#if defined(PEELO_JSON_ENABLE_INTRUSIVE_REFCOUNT)
+  REQUIRE(sizeof(value) == sizeof(void*));
+#endif
+}
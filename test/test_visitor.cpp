@@ -71,3 +71,64 @@ TEST_CASE("Visitor should detect JSON value types", "[accept]")
   REQUIRE(visitor.object_count == 1);
   REQUIRE(visitor.string_count == 1);
 }
+
+class static_visitor
+{
+public:
+  int count = 0;
+  double sum = 0;
+
+  void visit_array(const array::container_type& elements)
+  {
+    ++count;
+    for (const auto& element : elements)
+    {
+      accept(*this, element);
+    }
+  }
+
+  void visit_boolean(bool)
+  {
+    ++count;
+  }
+
+  void visit_null()
+  {
+    ++count;
+  }
+
+  void visit_number(double value)
+  {
+    ++count;
+    sum += value;
+  }
+
+  void visit_object(const object::container_type& properties)
+  {
+    ++count;
+    for (const auto& property : properties)
+    {
+      accept(*this, property.second);
+    }
+  }
+
+  void visit_string(const string::value_type&)
+  {
+    ++count;
+  }
+};
+
+TEST_CASE("Visitor without base class is dispatched statically", "[accept]")
+{
+  static_visitor visitor;
+
+  accept(visitor, array::make({
+    number::make(1),
+    object::make({ { U"a", number::make(2) }, { U"b", nullptr } }),
+    string::make(U"foo"),
+    boolean::make(false),
+  }));
+
+  REQUIRE(visitor.count == 7);
+  REQUIRE(visitor.sum == 3);
+}